@@ -0,0 +1,227 @@
+/* threshold alarms with hysteresis, reported to a hook */
+
+/*
+*  -w checks each new data point against the thresholds of its logger, as
+*  set with -c. a value above thresh_high raises the high alarm, below
+*  thresh_low the low alarm. the alarm ends only once the value is back
+*  inside by the hysteresis, so a value wobbling around a threshold does
+*  not flap.
+*
+*  each change of the state of temp or rh goes to the hook:
+*
+*   a fifo        gets one line, written without blocking, dropped if
+*                 nobody reads the fifo:
+*                 TIME LOGNAME temp|rh high|low|normal VALUE THRESHOLD HELD
+*   anything else is run with /bin/sh -c, not waited for, with the line in
+*                 VDL120_TIME, VDL120_LOGGER, VDL120_QUANTITY, VDL120_STATE,
+*                 VDL120_VALUE, VDL120_THRESHOLD and VDL120_HELD
+*
+*  the hook fires at most once per holdoff for each logger and quantity.
+*  changes within the holdoff are held back: when it is over and the state
+*  differs from the one reported last, the current state is reported, HELD
+*  tells how many changes were held back.
+*/
+
+#define ALARM_NORMAL 0
+#define ALARM_HIGH 1
+#define ALARM_LOW 2
+
+struct alarm_channel {
+	int state;
+	int reported;                   /* state last given to the hook */
+	int value;                      /* tenths, of the last change */
+	int threshold;                  /* whole units */
+	long long time;                 /* data time of the last change */
+	double fired;                   /* monotonic time of the last hook, seconds */
+	int held;                       /* changes since the last hook */
+};
+
+struct alarm {
+	struct alarm_channel temp;
+	struct alarm_channel rh;
+};
+
+char *alarm_hook = NULL;    /* fifo or shell command, set by -w, NULL = no alarms */
+int alarm_hysteresis = 0;   /* tenths */
+int alarm_holdoff = 0;      /* seconds */
+
+void alarm_init(struct alarm *a);
+int alarm_check(struct alarm *a, struct config *cfg, struct data *data_first);
+double alarm_pending(struct alarm *a);
+
+extern char **environ;
+
+
+static double alarm_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void alarm_init(struct alarm *a)
+{
+	memset(a, 0, sizeof(*a));
+	a->temp.fired = a->rh.fired = -1e9;
+}
+
+static int alarm_state(int state, int value, int low, int high)
+{
+	if (value > high)
+		return ALARM_HIGH;
+	if (value < low)
+		return ALARM_LOW;
+	if (state == ALARM_HIGH && value > high - alarm_hysteresis)
+		return ALARM_HIGH;
+	if (state == ALARM_LOW && value < low + alarm_hysteresis)
+		return ALARM_LOW;
+	return ALARM_NORMAL;
+}
+
+/* hand one line to the hook, return value: 0 = delivered or started */
+static int alarm_fire(char *name, char *quantity, struct alarm_channel *ch)
+{
+	static char *state_names[] = { "normal", "high", "low" };
+	char line[256], time_str[32], value_str[16], threshold_str[16], held_str[16];
+	char env[7][64], *envp[512];
+	struct stat st;
+	struct tm tm;
+	time_t time_stamp = ch->time;
+	int fd, i, n, ret;
+	pid_t pid;
+
+	gmtime_r(&time_stamp, &tm);
+	strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%S", &tm);
+	snprintf(value_str, sizeof(value_str), "%.1f", ch->value / 10.0);
+	snprintf(threshold_str, sizeof(threshold_str), "%i", ch->threshold);
+	snprintf(held_str, sizeof(held_str), "%i", ch->held > 0 ? ch->held - 1 : 0);
+	snprintf(line, sizeof(line), "%s %.16s %s %s %s %s %s\n",
+		time_str, name, quantity, state_names[ch->state], value_str, threshold_str, held_str);
+
+	printf("alarm: %s", line);
+	fflush(stdout);
+
+	if (0 == stat(alarm_hook, &st) && S_ISFIFO(st.st_mode))
+	{
+		/* less than PIPE_BUF, so lines of several loggers never mix */
+		fd = open(alarm_hook, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+		if (fd < 0)
+		{
+			printf("alarm: no reader on %s, line dropped\n", alarm_hook);
+			return 1;
+		}
+		ret = write(fd, line, strlen(line));
+		close(fd);
+		if (ret != strlen(line))
+		{
+			printf("alarm: failed to write to %s\n", alarm_hook);
+			return 1;
+		}
+		return 0;
+	}
+
+	/* build the environment before fork, the child only calls exec */
+	snprintf(env[0], sizeof(env[0]), "VDL120_TIME=%s", time_str);
+	snprintf(env[1], sizeof(env[1]), "VDL120_LOGGER=%.16s", name);
+	snprintf(env[2], sizeof(env[2]), "VDL120_QUANTITY=%s", quantity);
+	snprintf(env[3], sizeof(env[3]), "VDL120_STATE=%s", state_names[ch->state]);
+	snprintf(env[4], sizeof(env[4]), "VDL120_VALUE=%s", value_str);
+	snprintf(env[5], sizeof(env[5]), "VDL120_THRESHOLD=%s", threshold_str);
+	snprintf(env[6], sizeof(env[6]), "VDL120_HELD=%s", held_str);
+	for (n = 0; n < 7; n++)
+		envp[n] = env[n];
+	for (i = 0; environ[i] != NULL && n < 511; i++)
+		if (0 != strncmp(environ[i], "VDL120_", 7))
+			envp[n++] = environ[i];
+	envp[n] = NULL;
+
+	/* reap hooks that have finished meanwhile */
+	while (waitpid(-1, NULL, WNOHANG) > 0)
+		;
+
+	pid = fork();
+	if (pid < 0)
+	{
+		printf("alarm: fork failed: %s\n", strerror(errno));
+		return 1;
+	}
+	if (pid == 0)
+	{
+		execle("/bin/sh", "sh", "-c", alarm_hook, (char *)NULL, envp);
+		_exit(127);
+	}
+	return 0;
+}
+
+static void alarm_update(struct alarm_channel *ch, long long time, int value, int low, int high)
+{
+	int state = alarm_state(ch->state, value, low * 10, high * 10);
+
+	if (state == ch->state)
+		return;
+	/* back to normal gives the threshold left */
+	ch->threshold = state == ALARM_HIGH || (state == ALARM_NORMAL && ch->state == ALARM_HIGH) ? high : low;
+	ch->state = state;
+	ch->value = value;
+	ch->time = time;
+	ch->held++;
+}
+
+static void alarm_report(char *name, char *quantity, struct alarm_channel *ch, double now)
+{
+	if (ch->state == ch->reported || now - ch->fired < alarm_holdoff)
+		return;
+	alarm_fire(name, quantity, ch);
+	ch->reported = ch->state;
+	ch->fired = now;
+	ch->held = 0;
+}
+
+/* check new data, data_first may be NULL to report held back changes only */
+int alarm_check(struct alarm *a, struct config *cfg, struct data *data_first)
+{
+	struct data *data_curr;
+	double now;
+
+	if (alarm_hook == NULL)
+		return 0;
+	for (data_curr = data_first; data_curr != NULL; data_curr = data_curr->next)
+	{
+		alarm_update(&a->temp, data_curr->time, data_curr->temp,
+			config_thresh_temp_low(cfg), config_thresh_temp_high(cfg));
+		alarm_update(&a->rh, data_curr->time, data_curr->rh,
+			config_thresh_rh_low(cfg), config_thresh_rh_high(cfg));
+
+		/* each data point may fire, so a short excursion between */
+		/* two polls is reported like any other */
+		now = alarm_now();
+		alarm_report(config_name(cfg), "temp", &a->temp, now);
+		alarm_report(config_name(cfg), "rh", &a->rh, now);
+	}
+
+	now = alarm_now();
+	alarm_report(config_name(cfg), "temp", &a->temp, now);
+	alarm_report(config_name(cfg), "rh", &a->rh, now);
+	return 0;
+}
+
+/* seconds until a held back change can be reported, -1 = none */
+double alarm_pending(struct alarm *a)
+{
+	struct alarm_channel *ch[2] = { &a->temp, &a->rh };
+	double now = alarm_now(), wait = -1, w;
+	int i;
+
+	for (i = 0; i < 2; i++)
+	{
+		if (ch[i]->state == ch[i]->reported)
+			continue;
+		w = ch[i]->fired + alarm_holdoff - now;
+		if (w < 0)
+			w = 0;
+		if (wait < 0 || w < wait)
+			wait = w;
+	}
+	return wait;
+}
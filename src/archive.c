@@ -0,0 +1,321 @@
+/* crash-safe appends to LOGNAME.dat: session trailers and group commit */
+
+/*
+*  each session appended by store_data ends with a trailer line:
+*
+*   # end POINTS points, BYTES bytes, crc32 CRC
+*
+*  BYTES and CRC (crc32 as in zlib, hex) cover the session from its
+*  header line up to the trailer. a session with suspect data points has
+*  their summary behind, e.g. ', 3 suspect: temp 0 range 2 spike ...',
+*  see fault.c. before the next append, archive_recover
+*  checks the last session of the file: without a valid trailer it was
+*  cut short by a crash and is removed. sessions written before there were
+*  trailers are kept if they end with a complete line and have all the
+*  points their header promises. LOGNAME.hist is then rebuilt from the
+*  archive, as the sketches may hold some of the removed session. it is
+*  rebuilt as well if its last record does not end with the last data
+*  point of the archive: both files share one sync, and a crash before
+*  it may leave either of them without the session.
+*
+*  a session counts as stored once archive_commit returns. it syncs the
+*  files of all sessions handed to it meanwhile at once: the first caller
+*  syncs, callers arriving during that sync queue up and the next one to
+*  wake syncs all of them together, with syncfs if they are more than
+*  one request on the same filesystem, else with fsync of each file, as
+*  syncfs also writes back whatever else is dirty there. so loggers
+*  finishing together share one journal commit instead of paying one
+*  each, and a lone download pays exactly one.
+*/
+
+#define ARCHIVE_TRAILER "# end "
+#define ARCHIVE_MAX_FDS 4
+
+struct store {
+	FILE *file;
+	char path[1024];
+	long offset;                    /* size of the file before the session */
+	long len;                       /* bytes of the session so far */
+	unsigned int crc;
+	int num_data;
+	struct fault fault;             /* of the data points so far */
+	struct data *pending;           /* not written yet, see store_point */
+};
+
+struct archive_req {
+	int fd[ARCHIVE_MAX_FDS];
+	int num_fds;
+	int ret;
+	int done;
+	struct archive_req *next;
+};
+
+pthread_mutex_t archive_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t archive_cond = PTHREAD_COND_INITIALIZER;
+struct archive_req *archive_queue = NULL;
+int archive_syncing = 0;
+
+unsigned int archive_crc(unsigned int crc, const char *buf, long len);
+void archive_put(struct store *st, const char *buf, int len);
+int archive_trailer(struct store *st);
+int archive_is_trailer(char *line);
+int archive_recover(char *path, int *removed, long long *time_last);
+int archive_commit(int *fds, int num_fds);
+
+
+static unsigned int archive_crc_table[256];
+static pthread_once_t archive_crc_once = PTHREAD_ONCE_INIT;
+
+static void archive_crc_init(void)
+{
+	unsigned int c;
+	int i, k;
+
+	for (i = 0; i < 256; i++)
+	{
+		for (c = i, k = 0; k < 8; k++)
+			c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+		archive_crc_table[i] = c;
+	}
+}
+
+unsigned int archive_crc(unsigned int crc, const char *buf, long len)
+{
+	long i;
+
+	pthread_once(&archive_crc_once, archive_crc_init);
+	crc = ~crc;
+	for (i = 0; i < len; i++)
+		crc = archive_crc_table[(crc ^ (unsigned char)buf[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+void archive_put(struct store *st, const char *buf, int len)
+{
+	fwrite(buf, 1, len, st->file);
+	st->crc = archive_crc(st->crc, buf, len);
+	st->len += len;
+}
+
+int archive_trailer(struct store *st)
+{
+	char summary[128];
+
+	if (fault_summary(&st->fault, summary, sizeof(summary)) > 0)
+		return fprintf(st->file, ARCHIVE_TRAILER "%i points, %li bytes, crc32 %08x, %s\n",
+			st->num_data, st->len, st->crc, summary) < 0;
+	return fprintf(st->file, ARCHIVE_TRAILER "%i points, %li bytes, crc32 %08x\n",
+		st->num_data, st->len, st->crc) < 0;
+}
+
+int archive_is_trailer(char *line)
+{
+	return 0 == strncmp(line, ARCHIVE_TRAILER, strlen(ARCHIVE_TRAILER));
+}
+
+/* remove a torn last session, *time_last gets the time of the last */
+/* data point left, -1 = none or unknown */
+/* return value: 0 = file is fine now */
+int archive_recover(char *path, int *removed, long long *time_last)
+{
+	char *buf = NULL, prev[256];
+	long size, from, len, head, pos, next, trailer, cut = -1, want = 65536;
+	long bytes;
+	unsigned int crc;
+	int fd, points, num_lines, n, ret = 1;
+
+	*removed = 0;
+	*time_last = -1;
+	fd = open(path, O_RDWR);
+	if (fd < 0)
+		return errno == ENOENT ? 0 : 1;
+	size = lseek(fd, 0, SEEK_END);
+	if (size <= 0)
+	{
+		close(fd);
+		return size < 0;
+	}
+
+	/* read back from the end until the header of the last session */
+	while (1)
+	{
+		from = size > want ? size - want : 0;
+		len = size - from;
+		buf = realloc(buf, len + 1);
+		if (buf == NULL || pread(fd, buf, len, from) != len)
+			goto done;
+		buf[len] = '\0';
+
+		/* the first line is cut unless it starts the file */
+		pos = 0;
+		if (from > 0)
+		{
+			while (pos < len && buf[pos] != '\n')
+				pos++;
+			pos++;
+		}
+		head = -1;
+		for (; pos < len; pos = next)
+		{
+			for (next = pos; next < len && buf[next] != '\n'; next++)
+				;
+			next++;
+			if (0 == strncmp(buf + pos, "# [", 3))
+				head = pos;
+		}
+		if (head >= 0)
+			break;
+		if (from == 0)
+		{
+			/* no session header at all, not ours to judge */
+			ret = 0;
+			goto done;
+		}
+		want *= 4;
+	}
+
+	/* the trailer, if any, is the last line starting with it */
+	trailer = -1;
+	num_lines = 0;
+	for (pos = head; pos < len; pos = next)
+	{
+		for (next = pos; next < len && buf[next] != '\n'; next++)
+			;
+		next++;
+		if (archive_is_trailer(buf + pos))
+			trailer = pos;
+		else if (buf[pos] != '#' && trailer < 0)
+			num_lines++;
+	}
+
+	if (trailer >= 0)
+	{
+		for (pos = trailer; pos < len && buf[pos] != '\n'; pos++)
+			;
+		if (pos < len &&
+			3 == sscanf(buf + trailer, ARCHIVE_TRAILER "%d points, %ld bytes, crc32 %x", &points, &bytes, &crc) &&
+			bytes == trailer - head && crc == archive_crc(0, buf + head, bytes))
+		{
+			/* a good trailer, drop anything after it */
+			if (pos + 1 < len)
+				cut = from + pos + 1;
+		}
+		else
+			cut = from + head;
+	}
+	else
+	{
+		/* no trailer: torn if the session before has one, or if it is */
+		/* from before the trailers and incomplete */
+		n = from + head < (long)sizeof(prev) - 1 ? from + head : (long)sizeof(prev) - 1;
+		if (n > 0 && pread(fd, prev, n, from + head - n) == n)
+		{
+			prev[n] = '\0';
+			for (pos = n - 1; pos > 0 && prev[pos-1] != '\n'; pos--)
+				;
+			if (archive_is_trailer(prev + pos))
+				cut = from + head;
+		}
+		if (cut < 0 && (1 != sscanf(buf + head, "# [%*d-%*d-%*d %*d:%*d:%*d] %d points", &points) ||
+			num_lines < points || buf[len-1] != '\n'))
+			cut = from + head;
+	}
+
+	ret = 0;
+	if (cut < 0)
+	{
+		/* the session stays, its last data point is the archive's */
+		for (pos = head; pos < len && (trailer < 0 || pos < trailer); pos = next)
+		{
+			for (next = pos; next < len && buf[next] != '\n'; next++)
+				;
+			next++;
+			if (buf[pos] != '#' && buf[pos] != '\n')
+				*time_last = strtoll(buf + pos, NULL, 10);
+		}
+	}
+	else
+	{
+		printf("archive_recover: %s: removing %li bytes of an incomplete session\n", path, size - cut);
+		*removed = 1;
+		if (0 != ftruncate(fd, cut) || 0 != fsync(fd))
+		{
+			printf("archive_recover: failed to truncate %s: %s\n", path, strerror(errno));
+			ret = 1;
+		}
+	}
+
+done:
+	free(buf);
+	close(fd);
+	return ret;
+}
+
+/* sync fds to disk, together with those of concurrent callers */
+int archive_commit(int *fds, int num_fds)
+{
+	struct archive_req req, *batch, *r;
+	struct stat st;
+	dev_t dev = 0;
+	int i, n, num_reqs, same, ret;
+
+	memset(&req, 0, sizeof(req));
+	for (i = 0; i < num_fds && i < ARCHIVE_MAX_FDS; i++)
+		req.fd[req.num_fds++] = fds[i];
+
+	pthread_mutex_lock(&archive_lock);
+	req.next = archive_queue;
+	archive_queue = &req;
+	while (!req.done)
+	{
+		if (archive_syncing)
+		{
+			pthread_cond_wait(&archive_cond, &archive_lock);
+			continue;
+		}
+
+		/* take everything queued so far, ours included */
+		batch = archive_queue;
+		archive_queue = NULL;
+		archive_syncing = 1;
+		pthread_mutex_unlock(&archive_lock);
+
+		n = 0;
+		num_reqs = 0;
+		same = 1;
+		for (r = batch; r != NULL; r = r->next)
+		{
+			num_reqs++;
+			for (i = 0; i < r->num_fds; i++, n++)
+			{
+				if (0 != fstat(r->fd[i], &st))
+					same = 0;
+				else if (n == 0)
+					dev = st.st_dev;
+				else if (st.st_dev != dev)
+					same = 0;
+			}
+		}
+
+		ret = 0;
+		if (num_reqs > 1 && same)
+			ret = syncfs(batch->fd[0]);
+		else
+			for (r = batch; r != NULL; r = r->next)
+				for (i = 0; i < r->num_fds; i++)
+					ret |= fsync(r->fd[i]);
+		if (ret != 0)
+			printf("archive_commit: sync failed: %s\n", strerror(errno));
+
+		pthread_mutex_lock(&archive_lock);
+		for (r = batch; r != NULL; r = r->next)
+		{
+			r->ret = ret != 0;
+			r->done = 1;
+		}
+		archive_syncing = 0;
+		pthread_cond_broadcast(&archive_cond);
+	}
+	pthread_mutex_unlock(&archive_lock);
+	return req.ret;
+}
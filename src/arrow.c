@@ -0,0 +1,480 @@
+/* write Apache Arrow IPC files (aka Feather v2) */
+
+/*
+*  the file holds three columns:
+*
+*   time  timestamp[s]  start time + n * interval, like print_data
+*   temp  float         temperature in °C or °F
+*   rh    float         relative humidity in %
+*
+*  one record batch per logging session. key/value metadata goes into
+*  the schema (per file) and into the batch messages (per session).
+*
+*  the flatbuffers are built back to front without the flatbuffers
+*  library, see format/Schema.fbs, Message.fbs and File.fbs in the
+*  Arrow sources for the tables and field numbers used below.
+*/
+
+#define ARROW_MAGIC "ARROW1\0\0"
+#define ARROW_V5 4                /* MetadataVersion */
+#define ARROW_SCHEMA 1            /* MessageHeader */
+#define ARROW_RECORD_BATCH 3
+#define ARROW_TYPE_FLOAT 3        /* Type */
+#define ARROW_TYPE_TIMESTAMP 10
+#define ARROW_MAX_BATCHES 65536
+
+
+/* flatbuffer builder, data grows from the end of buf towards the front */
+
+struct fb {
+	unsigned char *buf;
+	int cap;
+	int len;         /* bytes used, at the end of buf */
+	int minalign;
+	int table_end;   /* len when the current table was started */
+	int field[8];    /* len after each field of the current table, 0 = unset */
+	int num_fields;
+};
+
+void fb_grow(struct fb *b, int size)
+{
+	unsigned char *buf;
+	int cap;
+
+	if (b->len + size <= b->cap)
+		return;
+
+	cap = b->cap ? b->cap : 256;
+	while (cap < b->len + size)
+		cap *= 2;
+	buf = malloc(cap);
+	if (b->len > 0)
+		memcpy(buf + cap - b->len, b->buf + b->cap - b->len, b->len);
+	free(b->buf);
+	b->buf = buf;
+	b->cap = cap;
+}
+
+void fb_push(struct fb *b, void *bytes, int size)
+{
+	if (size == 0)
+		return;
+	fb_grow(b, size);
+	b->len += size;
+	memcpy(b->buf + b->cap - b->len, bytes, size);
+}
+
+void fb_push_le(struct fb *b, long long value, int size)
+{
+	unsigned char bytes[8];
+	int i;
+
+	for (i = 0; i < size; i++)
+		bytes[i] = (value >> (8*i)) & 0xFF;
+	fb_push(b, bytes, size);
+}
+
+/* pad so that 'size' bytes pushed next end up aligned to 'align' */
+void fb_prep(struct fb *b, int align, int size)
+{
+	if (align > b->minalign)
+		b->minalign = align;
+	while ((b->len + size) % align != 0)
+		fb_push_le(b, 0, 1);
+}
+
+/* push an offset to an object built before, return value: position */
+int fb_push_offset(struct fb *b, int target)
+{
+	fb_prep(b, 4, 4);
+	fb_push_le(b, b->len + 4 - target, 4);
+	return b->len;
+}
+
+int fb_string(struct fb *b, char *str)
+{
+	int size = strlen(str);
+
+	fb_prep(b, 4, size + 1 + 4);
+	fb_push_le(b, 0, 1);
+	fb_push(b, str, size);
+	fb_push_le(b, size, 4);
+	return b->len;
+}
+
+int fb_offset_vector(struct fb *b, int *targets, int num)
+{
+	int i;
+
+	fb_prep(b, 4, 4 * num + 4);
+	for (i = num - 1; i >= 0; i--)
+		fb_push_offset(b, targets[i]);
+	fb_push_le(b, num, 4);
+	return b->len;
+}
+
+/* vector of structs, all fields 8 byte aligned */
+int fb_struct_vector(struct fb *b, void *structs, int size, int num)
+{
+	fb_prep(b, 4, size * num);
+	fb_prep(b, 8, size * num);
+	fb_push(b, structs, size * num);
+	fb_push_le(b, num, 4);
+	return b->len;
+}
+
+void fb_table_start(struct fb *b, int num_fields)
+{
+	b->table_end = b->len;
+	b->num_fields = num_fields;
+	memset(b->field, 0, sizeof(b->field));
+}
+
+void fb_table_scalar(struct fb *b, int field, long long value, int size)
+{
+	fb_prep(b, size, size);
+	fb_push_le(b, value, size);
+	b->field[field] = b->len;
+}
+
+void fb_table_offset(struct fb *b, int field, int target)
+{
+	b->field[field] = fb_push_offset(b, target);
+}
+
+int fb_table_end(struct fb *b)
+{
+	int table, vtable, i;
+	unsigned char *soffset;
+
+	/* placeholder for the offset to the vtable */
+	fb_prep(b, 4, 4);
+	fb_push_le(b, 0, 4);
+	table = b->len;
+
+	for (i = b->num_fields - 1; i >= 0; i--)
+		fb_push_le(b, b->field[i] ? table - b->field[i] : 0, 2);
+	fb_push_le(b, table - b->table_end, 2);
+	fb_push_le(b, 4 + 2 * b->num_fields, 2);
+	vtable = b->len;
+
+	soffset = b->buf + b->cap - table;
+	for (i = 0; i < 4; i++)
+		soffset[i] = ((vtable - table) >> (8*i)) & 0xFF;
+
+	return table;
+}
+
+/* return value: pointer to the finished buffer of b->len bytes */
+unsigned char *fb_finish(struct fb *b, int root)
+{
+	fb_prep(b, b->minalign > 8 ? b->minalign : 8, 4);
+	fb_push_offset(b, root);
+	return b->buf + b->cap - b->len;
+}
+
+void fb_free(struct fb *b)
+{
+	free(b->buf);
+	memset(b, 0, sizeof(*b));
+}
+
+
+/* arrow file writer */
+
+struct arrow_block {
+	long long offset;
+	int meta_len;
+	int padding;
+	long long body_len;
+};
+
+struct arrow_file {
+	FILE *file;
+	long long pos;
+	int num_meta;
+	char **meta;   /* schema metadata: key, value, key, value, ... */
+	int num_blocks;
+	struct arrow_block *blocks;
+};
+
+int                         /* return value: 0 = success */
+arrow_open(
+	struct arrow_file *af,
+	char *path,
+	int num_meta,           /* number of key/value pairs */
+	char **meta             /* schema metadata: key, value, key, value, ... */
+);
+
+int                         /* return value: 0 = success */
+arrow_write_batch(
+	struct arrow_file *af,
+	int num_data,
+	long long *time,
+	float *temp,
+	float *rh,
+	int num_meta,           /* number of key/value pairs */
+	char **meta             /* batch metadata: key, value, key, value, ... */
+);
+
+int                         /* return value: 0 = success */
+arrow_close(
+	struct arrow_file *af
+);
+
+
+int arrow_metadata(struct fb *b, int num_meta, char **meta)
+{
+	int pairs[num_meta > 0 ? num_meta : 1];
+	int key, value, i;
+
+	for (i = 0; i < num_meta; i++)
+	{
+		key = fb_string(b, meta[2*i]);
+		value = fb_string(b, meta[2*i+1]);
+		fb_table_start(b, 2); /* KeyValue */
+		fb_table_offset(b, 0, key);
+		fb_table_offset(b, 1, value);
+		pairs[i] = fb_table_end(b);
+	}
+	return fb_offset_vector(b, pairs, num_meta);
+}
+
+int arrow_field(struct fb *b, char *name, int type_type, int type)
+{
+	int name_off, children;
+
+	name_off = fb_string(b, name);
+	children = fb_offset_vector(b, NULL, 0);
+	fb_table_start(b, 7); /* Field */
+	fb_table_offset(b, 0, name_off);
+	fb_table_offset(b, 3, type);
+	fb_table_offset(b, 5, children);
+	fb_table_scalar(b, 1, 0, 1); /* nullable */
+	fb_table_scalar(b, 2, type_type, 1);
+	return fb_table_end(b);
+}
+
+int arrow_schema(struct fb *b, int num_meta, char **meta)
+{
+	int fields[3], type, metadata, fields_vec;
+
+	fb_table_start(b, 2); /* Timestamp */
+	fb_table_scalar(b, 0, 0, 2); /* unit: SECOND, no timezone = wall clock */
+	type = fb_table_end(b);
+	fields[0] = arrow_field(b, "time", ARROW_TYPE_TIMESTAMP, type);
+
+	fb_table_start(b, 1); /* FloatingPoint */
+	fb_table_scalar(b, 0, 1, 2); /* precision: SINGLE */
+	type = fb_table_end(b);
+	fields[1] = arrow_field(b, "temp", ARROW_TYPE_FLOAT, type);
+
+	fb_table_start(b, 1);
+	fb_table_scalar(b, 0, 1, 2);
+	type = fb_table_end(b);
+	fields[2] = arrow_field(b, "rh", ARROW_TYPE_FLOAT, type);
+
+	fields_vec = fb_offset_vector(b, fields, 3);
+	metadata = arrow_metadata(b, num_meta, meta);
+
+	fb_table_start(b, 3); /* Schema */
+	fb_table_offset(b, 1, fields_vec);
+	fb_table_offset(b, 2, metadata);
+	fb_table_scalar(b, 0, 0, 2); /* endianness: little */
+	return fb_table_end(b);
+}
+
+/* write an encapsulated message, return value: metadata length incl. prefix */
+int arrow_message(struct arrow_file *af, struct fb *b, int header_type, int header,
+	long long body_len, int num_meta, char **meta)
+{
+	unsigned char prefix[8] = { 0xFF, 0xFF, 0xFF, 0xFF };
+	unsigned char zero[8] = { 0 };
+	unsigned char *bytes;
+	int metadata = 0, message, size, padded, i;
+
+	if (num_meta > 0)
+		metadata = arrow_metadata(b, num_meta, meta);
+
+	fb_table_start(b, 5); /* Message */
+	fb_table_scalar(b, 3, body_len, 8);
+	fb_table_offset(b, 2, header);
+	if (num_meta > 0)
+		fb_table_offset(b, 4, metadata);
+	fb_table_scalar(b, 0, ARROW_V5, 2);
+	fb_table_scalar(b, 1, header_type, 1);
+	message = fb_table_end(b);
+	bytes = fb_finish(b, message);
+
+	size = b->len;
+	padded = (size + 7) & ~7;
+	for (i = 0; i < 4; i++)
+		prefix[4+i] = (padded >> (8*i)) & 0xFF;
+
+	fwrite(prefix, 1, 8, af->file);
+	fwrite(bytes, 1, size, af->file);
+	fwrite(zero, 1, padded - size, af->file);
+	af->pos += 8 + padded;
+
+	return 8 + padded;
+}
+
+int arrow_open(struct arrow_file *af, char *path, int num_meta, char **meta)
+{
+	struct fb b = { 0 };
+	int i;
+
+	memset(af, 0, sizeof(*af));
+	af->file = fopen(path, "wb");
+	if (af->file == NULL)
+	{
+		printf("arrow_open: failed to fopen(\"%s\", \"wb\")\n", path);
+		return 1;
+	}
+
+	/* keep the schema metadata for the footer */
+	af->num_meta = num_meta;
+	af->meta = malloc(sizeof(char *) * 2 * (num_meta > 0 ? num_meta : 1));
+	for (i = 0; i < 2 * num_meta; i++)
+		af->meta[i] = strdup(meta[i]);
+	af->blocks = malloc(sizeof(struct arrow_block) * ARROW_MAX_BATCHES);
+
+	fwrite(ARROW_MAGIC, 1, 8, af->file);
+	af->pos = 8;
+
+	arrow_message(af, &b, ARROW_SCHEMA, arrow_schema(&b, num_meta, meta), 0, 0, NULL);
+	fb_free(&b);
+
+	return 0;
+}
+
+int arrow_write_batch(struct arrow_file *af, int num_data, long long *time, float *temp, float *rh,
+	int num_meta, char **meta)
+{
+	struct fb b = { 0 };
+	long long nodes[3][2], buffers[6][2];
+	long long time_len, float_len, body_len;
+	unsigned char zero[8] = { 0 };
+	int nodes_vec, buffers_vec, batch, i;
+	struct arrow_block *block;
+
+	if (af->num_blocks == ARROW_MAX_BATCHES)
+	{
+		printf("arrow_write_batch: too many batches\n");
+		return 1;
+	}
+
+	/* body: no validity bitmaps, just the values, each padded to 8 bytes */
+	time_len = 8LL * num_data;
+	float_len = (4LL * num_data + 7) & ~7;
+	body_len = time_len + 2 * float_len;
+
+	for (i = 0; i < 3; i++)
+	{
+		nodes[i][0] = num_data; /* length */
+		nodes[i][1] = 0;        /* null_count */
+	}
+	buffers[0][0] = 0;                    buffers[0][1] = 0;
+	buffers[1][0] = 0;                    buffers[1][1] = time_len;
+	buffers[2][0] = time_len;             buffers[2][1] = 0;
+	buffers[3][0] = time_len;             buffers[3][1] = 4LL * num_data;
+	buffers[4][0] = time_len + float_len; buffers[4][1] = 0;
+	buffers[5][0] = time_len + float_len; buffers[5][1] = 4LL * num_data;
+
+	/* the struct vectors are written as raw bytes, so fix their byte order */
+	for (i = 0; i < 3; i++)
+	{
+		nodes[i][0] = htole64(nodes[i][0]);
+		nodes[i][1] = htole64(nodes[i][1]);
+	}
+	for (i = 0; i < 6; i++)
+	{
+		buffers[i][0] = htole64(buffers[i][0]);
+		buffers[i][1] = htole64(buffers[i][1]);
+	}
+
+	nodes_vec = fb_struct_vector(&b, nodes, 16, 3);
+	buffers_vec = fb_struct_vector(&b, buffers, 16, 6);
+	fb_table_start(&b, 3); /* RecordBatch */
+	fb_table_scalar(&b, 0, num_data, 8);
+	fb_table_offset(&b, 1, nodes_vec);
+	fb_table_offset(&b, 2, buffers_vec);
+	batch = fb_table_end(&b);
+
+	block = &af->blocks[af->num_blocks++];
+	block->offset = af->pos;
+	block->meta_len = arrow_message(af, &b, ARROW_RECORD_BATCH, batch, body_len, num_meta, meta);
+	block->padding = 0;
+	block->body_len = body_len;
+	fb_free(&b);
+
+	/* arrow wants little endian, so do the host */
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+	for (i = 0; i < num_data; i++)
+	{
+		time[i] = htole64(time[i]);
+		*(int *)&temp[i] = htole32(*(int *)&temp[i]);
+		*(int *)&rh[i] = htole32(*(int *)&rh[i]);
+	}
+#endif
+	fwrite(time, 8, num_data, af->file);
+	fwrite(temp, 4, num_data, af->file);
+	fwrite(zero, 1, float_len - 4LL * num_data, af->file);
+	fwrite(rh, 4, num_data, af->file);
+	fwrite(zero, 1, float_len - 4LL * num_data, af->file);
+	af->pos += body_len;
+
+	return 0;
+}
+
+int arrow_close(struct arrow_file *af)
+{
+	struct fb b = { 0 };
+	unsigned char eos[8] = { 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0 };
+	unsigned char size_le[4];
+	unsigned char *bytes;
+	int schema, dictionaries, batches, footer, ret = 0, i;
+
+	fwrite(eos, 1, 8, af->file);
+
+	for (i = 0; i < af->num_blocks; i++)
+	{
+		af->blocks[i].offset = htole64(af->blocks[i].offset);
+		af->blocks[i].meta_len = htole32(af->blocks[i].meta_len);
+		af->blocks[i].body_len = htole64(af->blocks[i].body_len);
+	}
+
+	schema = arrow_schema(&b, af->num_meta, af->meta);
+	dictionaries = fb_struct_vector(&b, NULL, 24, 0);
+	batches = fb_struct_vector(&b, af->blocks, 24, af->num_blocks);
+	fb_table_start(&b, 4); /* Footer */
+	fb_table_offset(&b, 1, schema);
+	fb_table_offset(&b, 2, dictionaries);
+	fb_table_offset(&b, 3, batches);
+	fb_table_scalar(&b, 0, ARROW_V5, 2);
+	footer = fb_table_end(&b);
+	bytes = fb_finish(&b, footer);
+
+	for (i = 0; i < 4; i++)
+		size_le[i] = (b.len >> (8*i)) & 0xFF;
+	fwrite(bytes, 1, b.len, af->file);
+	fwrite(size_le, 1, 4, af->file);
+	fwrite(ARROW_MAGIC, 1, 6, af->file);
+	fb_free(&b);
+
+	if (ferror(af->file))
+	{
+		printf("arrow_close: write error\n");
+		ret = 1;
+	}
+	if (fclose(af->file) != 0)
+		ret = 1;
+
+	for (i = 0; i < 2 * af->num_meta; i++)
+		free(af->meta[i]);
+	free(af->meta);
+	free(af->blocks);
+	memset(af, 0, sizeof(*af));
+
+	return ret;
+}
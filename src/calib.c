@@ -0,0 +1,210 @@
+/* per logger calibration, applied while decoding the data */
+
+/*
+*  calibration file, one line per logger and quantity:
+*
+*   KEY  QUANTITY  OFFSET  GAIN  [RAW:TRUE ...]
+*
+*  KEY is the logger name or its usb location "usb:BUS/DEVICE", the
+*  location wins if both match. QUANTITY is temp or rh. the optional
+*  RAW:TRUE points describe a piecewise linear curve, sorted by RAW,
+*  extended linearly beyond the first and last segment. the corrected
+*  value is
+*
+*   OFFSET + GAIN * curve(raw)
+*
+*  with curve(raw) = raw if there are no points. '#' starts a comment.
+*
+*  e.g.
+*
+*   cellar       temp  -0.3  1.00
+*   cellar       rh     0.0  1.00  20:21.5 50:52.0 80:81.0
+*   usb:001/004  temp   0.2  0.98
+*/
+
+#define CALIB_MAX_POINTS 16
+
+struct calib_curve {
+	float offset;
+	float gain;
+	int num_points;
+	float raw[CALIB_MAX_POINTS];
+	float cal[CALIB_MAX_POINTS];
+};
+
+struct calib {
+	char key[32];
+	struct calib_curve temp;
+	struct calib_curve rh;
+	struct calib *next;
+};
+
+struct calib *calib_first = NULL; /* loaded by -C */
+int calib_keep_raw = 0;           /* bool: store raw values next to the calibrated ones, -K */
+
+int calib_load(char *path);
+struct calib *calib_find(char *name, char *location);
+void calib_apply(struct calib *cal, short int *temp, short int *rh, int num);
+void calib_free(void);
+
+
+int calib_load(char *path)
+{
+	FILE *file;
+	struct calib *cal;
+	struct calib_curve *curve;
+	char line[1024], key[32], quantity[8], *pos, *end;
+	float offset, gain;
+	int num_line = 0, n;
+
+	file = fopen(path, "r");
+	if (file == NULL)
+	{
+		printf("calib_load: failed to fopen(\"%s\", \"r\")\n", path);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		num_line++;
+		if ((pos = strchr(line, '#')) != NULL)
+			*pos = 0;
+		if (1 > sscanf(line, "%31s", key))
+			continue;
+
+		if (4 != sscanf(line, "%31s %7s %f %f%n", key, quantity, &offset, &gain, &n) ||
+			(0 != strcmp(quantity, "temp") && 0 != strcmp(quantity, "rh")))
+		{
+			printf("calib_load: %s:%i: expected KEY temp|rh OFFSET GAIN [RAW:TRUE ...]\n", path, num_line);
+			fclose(file);
+			return 1;
+		}
+
+		for (cal = calib_first; cal != NULL; cal = cal->next)
+			if (0 == strcmp(cal->key, key))
+				break;
+		if (cal == NULL)
+		{
+			cal = calloc(1, sizeof(struct calib));
+			strcpy(cal->key, key);
+			cal->temp.gain = 1;
+			cal->rh.gain = 1;
+			cal->next = calib_first;
+			calib_first = cal;
+		}
+
+		curve = 0 == strcmp(quantity, "temp") ? &cal->temp : &cal->rh;
+		curve->offset = offset;
+		curve->gain = gain;
+		curve->num_points = 0;
+
+		for (pos = line + n; ; pos = end)
+		{
+			while (*pos == ' ' || *pos == '\t')
+				pos++;
+			if (*pos == 0 || *pos == '\n' || *pos == '\r')
+				break;
+			if (curve->num_points == CALIB_MAX_POINTS ||
+				2 != sscanf(pos, "%f:%f", &curve->raw[curve->num_points], &curve->cal[curve->num_points]) ||
+				(curve->num_points > 0 && curve->raw[curve->num_points] <= curve->raw[curve->num_points - 1]))
+			{
+				printf("calib_load: %s:%i: invalid curve point, at most %i, sorted by RAW\n",
+					path, num_line, CALIB_MAX_POINTS);
+				fclose(file);
+				return 1;
+			}
+			curve->num_points++;
+			for (end = pos; *end != 0 && *end != ' ' && *end != '\t' && *end != '\n' && *end != '\r'; end++)
+				;
+		}
+		if (curve->num_points == 1)
+		{
+			printf("calib_load: %s:%i: a curve needs at least 2 points\n", path, num_line);
+			fclose(file);
+			return 1;
+		}
+	}
+
+	fclose(file);
+	return 0;
+}
+
+struct calib *calib_find(char *name, char *location)
+{
+	struct calib *cal, *by_name = NULL;
+	char key[17];
+
+	/* the config name is not terminated if it has 16 characters */
+	snprintf(key, sizeof(key), "%.16s", name);
+
+	for (cal = calib_first; cal != NULL; cal = cal->next)
+	{
+		if (location != NULL && location[0] != 0 && 0 == strcmp(cal->key, location))
+			return cal;
+		if (0 == strcmp(cal->key, key))
+			by_name = cal;
+	}
+	return by_name;
+}
+
+/* round to tenths, clamped to what a short int holds */
+static inline short int calib_round(float y)
+{
+	if (!(y >= SHRT_MIN))
+		return SHRT_MIN;
+	if (y > SHRT_MAX)
+		return SHRT_MAX;
+	return y < 0 ? y - 0.5f : y + 0.5f;
+}
+
+/* values in tenths, as decoded from the logger */
+void calib_curve_apply(struct calib_curve *curve, short int *value, int num)
+{
+	float offset = curve->offset * 10, gain = curve->gain, x, y;
+	int i, k;
+
+	if (curve->num_points == 0)
+	{
+		/* the common case, a plain loop the compiler can vectorize */
+		for (i = 0; i < num; i++)
+		{
+			y = offset + gain * value[i];
+			value[i] = calib_round(y);
+		}
+		return;
+	}
+
+	for (i = 0; i < num; i++)
+	{
+		x = value[i] / 10.0f;
+
+		/* segment containing x, the outer ones extended */
+		for (k = 1; k < curve->num_points - 1 && curve->raw[k] < x; k++)
+			;
+		y = curve->cal[k-1] + (x - curve->raw[k-1]) *
+			(curve->cal[k] - curve->cal[k-1]) / (curve->raw[k] - curve->raw[k-1]);
+
+		y = offset + gain * y * 10;
+		value[i] = calib_round(y);
+	}
+}
+
+void calib_apply(struct calib *cal, short int *temp, short int *rh, int num)
+{
+	if (cal == NULL)
+		return;
+	calib_curve_apply(&cal->temp, temp, num);
+	calib_curve_apply(&cal->rh, rh, num);
+}
+
+void calib_free(void)
+{
+	struct calib *cal;
+
+	while (calib_first != NULL)
+	{
+		cal = calib_first->next;
+		free(calib_first);
+		calib_first = cal;
+	}
+}
@@ -0,0 +1,83 @@
+/* which logs are stored already, so their download can be skipped */
+
+/*
+*  after store_data has stored a log completely, LOGNAME.cat holds its
+*  fingerprint, taken from the config alone:
+*
+*   START INTERVAL NUM_DATA_CONF NUM_DATA_REC NAME
+*
+*  a logger whose config gives the same fingerprint still holds exactly
+*  the log stored then: it is stopped, or has not recorded a new data
+*  point since, and was not re-armed (a new log gets a new start time).
+*  so -s, -r, -F and -H only read the config of such a logger and skip
+*  the download. remove LOGNAME.cat to store the log again.
+*/
+
+int catalog_has(struct config *cfg);
+int catalog_add(struct config *cfg, int num_data);
+
+
+static void catalog_fingerprint(struct config *cfg, char *buf, int size)
+{
+	snprintf(buf, size, "%04i-%02i-%02i %02i:%02i:%02i %i %i %i %.16s\n",
+		config_time_year(cfg), config_time_mon(cfg), config_time_mday(cfg),
+		config_time_hour(cfg), config_time_min(cfg), config_time_sec(cfg),
+		config_interval(cfg), config_num_data_conf(cfg), config_num_data_rec(cfg),
+		config_name(cfg));
+}
+
+/* return value: 1 = the log on the logger is in LOGNAME.dat already */
+int catalog_has(struct config *cfg)
+{
+	char path[64], fingerprint[128], line[128];
+	FILE *file;
+	int ret = 0;
+
+	if (config_num_data_rec(cfg) == 0)
+		return 0;
+
+	/* the archive may have been moved away since */
+	snprintf(path, sizeof(path), "%.16s.dat", config_name(cfg));
+	if (0 != access(path, F_OK))
+		return 0;
+
+	snprintf(path, sizeof(path), "%.16s.cat", config_name(cfg));
+	file = fopen(path, "r");
+	if (file == NULL)
+		return 0;
+	catalog_fingerprint(cfg, fingerprint, sizeof(fingerprint));
+	if (fgets(line, sizeof(line), file) != NULL && 0 == strcmp(line, fingerprint))
+		ret = 1;
+	fclose(file);
+	return ret;
+}
+
+/* the log was stored with num_data data points, synced */
+int catalog_add(struct config *cfg, int num_data)
+{
+	char path[64], tmp_path[80], fingerprint[128];
+	FILE *file;
+
+	/* a short download is no reason to skip the next one */
+	if (num_data != config_num_data_rec(cfg))
+		return 0;
+
+	/* replace it at once, a crash leaves the old one */
+	snprintf(path, sizeof(path), "%.16s.cat", config_name(cfg));
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	file = fopen(tmp_path, "w");
+	if (file == NULL)
+	{
+		printf("catalog_add: failed to fopen(\"%s\", \"w\")\n", tmp_path);
+		return 1;
+	}
+	catalog_fingerprint(cfg, fingerprint, sizeof(fingerprint));
+	fputs(fingerprint, file);
+	if (0 != fclose(file) || 0 != rename(tmp_path, path))
+	{
+		printf("catalog_add: failed to write %s\n", path);
+		unlink(tmp_path);
+		return 1;
+	}
+	return 0;
+}
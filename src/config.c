@@ -0,0 +1,137 @@
+/* logger config: accessors working directly on the 64 byte wire format */
+
+/*
+*  the config is kept as the bytes sent over usb, so it does not depend on
+*  compiler padding, host byte order or the signedness of char. each field
+*  is described once in CONFIG_FIELDS by name, offset and type; this
+*  generates an inline getter config_NAME(cfg) and setter
+*  config_set_NAME(cfg, value) for it.
+*
+*  field types:
+*
+*   u8      1 byte
+*   u32     4 bytes, little endian
+*   thresh  4 bytes, float32 little endian, only the upper half is used,
+*           get/set take whole numbers, see num2bin.c
+*   name    16 bytes, not terminated if all 16 are used, print with %.16s
+*/
+
+#define CONFIG_SIZE 64
+
+#define CONFIG_FIELDS(X) \
+	X(config_begin,        0, u32)    /* 0xce = set config, 0x00 = logger is active */ \
+	X(num_data_conf,       4, u32)    /* number of data configured */ \
+	X(num_data_rec,        8, u32)    /* number of data recorded */ \
+	X(interval,           12, u32)    /* log interval in seconds */ \
+	X(time_year,          16, u32)    /* start time, local (!) timezone */ \
+	X(thresh_temp_low,    20, thresh) \
+	X(thresh_temp_high,   24, thresh) \
+	X(time_mon,           28, u8) \
+	X(time_mday,          29, u8) \
+	X(time_hour,          30, u8) \
+	X(time_min,           31, u8) \
+	X(time_sec,           32, u8) \
+	X(temp_is_fahrenheit, 33, u8) \
+	X(led_conf,           34, u8)     /* bit 0: alarm on/off, bits 1-2: 10 (?), bits 3-7: flash frequency in seconds */ \
+	X(name,               35, name)   /* config name */ \
+	X(start,              51, u8)     /* 0x02 = start logging immediately; 0x01 = start logging manually */ \
+	X(thresh_rh_low,      52, thresh) \
+	X(thresh_rh_high,     56, thresh) \
+	X(config_end,         60, u32)    /* = config_begin */
+
+struct config {
+	unsigned char buf[CONFIG_SIZE]; /* as read from and written to the logger */
+};
+
+
+/* field types */
+
+#define CONFIG_WIDTH_u8 1
+#define CONFIG_WIDTH_u32 4
+#define CONFIG_WIDTH_thresh 4
+#define CONFIG_WIDTH_name 16
+
+typedef int config_u8_t;
+typedef int config_u32_t;
+typedef int config_thresh_t;
+typedef char *config_name_t;
+
+static inline int config_get_u8(unsigned char *p)
+{
+	return p[0];
+}
+
+static inline void config_put_u8(unsigned char *p, int value)
+{
+	p[0] = value & 0xFF;
+}
+
+static inline int config_get_u32(unsigned char *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+static inline void config_put_u32(unsigned char *p, int value)
+{
+	p[0] = value & 0xFF;
+	p[1] = (value >> 8) & 0xFF;
+	p[2] = (value >> 16) & 0xFF;
+	p[3] = (value >> 24) & 0xFF;
+}
+
+static inline int config_get_thresh(unsigned char *p)
+{
+	return bin2num((short int)(p[2] | p[3] << 8));
+}
+
+static inline void config_put_thresh(unsigned char *p, int value)
+{
+	unsigned short int bin = num2bin(value);
+
+	p[0] = 0;
+	p[1] = 0;
+	p[2] = bin & 0xFF;
+	p[3] = bin >> 8;
+}
+
+static inline char *config_get_name(unsigned char *p)
+{
+	return (char *)p;
+}
+
+static inline void config_put_name(unsigned char *p, char *value)
+{
+	strncpy((char *)p, value, CONFIG_WIDTH_name);
+}
+
+
+/* the layout must cover exactly the 64 bytes, checked at compile time */
+/* with a struct of byte arrays, which has no padding */
+
+#define CONFIG_LAYOUT(name, offset, type) unsigned char name[CONFIG_WIDTH_##type];
+struct config_layout {
+	CONFIG_FIELDS(CONFIG_LAYOUT)
+};
+#undef CONFIG_LAYOUT
+
+#define CONFIG_CHECK(name, offset, type) \
+	_Static_assert(offsetof(struct config_layout, name) == offset, "config field " #name " not at offset " #offset);
+CONFIG_FIELDS(CONFIG_CHECK)
+#undef CONFIG_CHECK
+
+_Static_assert(sizeof(struct config_layout) == CONFIG_SIZE, "config layout is not 64 bytes");
+
+
+/* accessors */
+
+#define CONFIG_ACCESSORS(name, offset, type) \
+	static inline config_##type##_t config_##name(struct config *cfg) \
+	{ \
+		return config_get_##type(cfg->buf + offset); \
+	} \
+	static inline void config_set_##name(struct config *cfg, config_##type##_t value) \
+	{ \
+		config_put_##type(cfg->buf + offset, value); \
+	}
+CONFIG_FIELDS(CONFIG_ACCESSORS)
+#undef CONFIG_ACCESSORS
@@ -0,0 +1,250 @@
+/* write log data into an SQLite database */
+
+/*
+*  the schema, created if missing:
+*
+*   logger   id, name
+*   session  id, logger, start, interval, num_data_conf, num_data_rec,
+*            fahrenheit and the thresholds (NULL when converted from a
+*            .dat file, which does not keep them), one per logging session
+*   sample   logger, time, session, temp, rh
+*
+*  times are unix times, the logger's local time taken as UTC as in the
+*  .dat files, temp and rh are in °C (°F) and %.
+*
+*  sample is a WITHOUT ROWID table with the primary key (logger, time),
+*  so the table itself is the covering index for time ranges of a logger
+*  and a sample stored twice, e.g. by downloading a log again, is kept
+*  once. the samples arrive in key order, so inserting only appends to
+*  the b-tree. all inserts go through prepared statements, in
+*  transactions of DB_BATCH samples.
+*/
+
+#define DB_BATCH 65536
+
+struct db {
+	sqlite3 *conn;
+	sqlite3_stmt *logger_ins;
+	sqlite3_stmt *logger_sel;
+	sqlite3_stmt *session_ins;
+	sqlite3_stmt *session_sel;
+	sqlite3_stmt *sample_ins;
+	long long logger;               /* ids of the current session */
+	long long session;
+	int batch;                      /* samples in the open transaction */
+	long long num_data;             /* samples handed to db_add */
+};
+
+int db_open(struct db *db, char *path);
+int db_session(struct db *db, char *name, struct config *cfg, int from_logger);
+int db_add(struct db *db, struct data *data_first);
+int db_close(struct db *db);
+
+
+static int db_exec(struct db *db, char *sql)
+{
+	char *err = NULL;
+
+	if (SQLITE_OK != sqlite3_exec(db->conn, sql, NULL, NULL, &err))
+	{
+		printf("db: %s: %s\n", sql, err);
+		sqlite3_free(err);
+		return 1;
+	}
+	return 0;
+}
+
+static int db_prepare(struct db *db, char *sql, sqlite3_stmt **stmt)
+{
+	if (SQLITE_OK != sqlite3_prepare_v2(db->conn, sql, -1, stmt, NULL))
+	{
+		printf("db: %s: %s\n", sql, sqlite3_errmsg(db->conn));
+		return 1;
+	}
+	return 0;
+}
+
+/* run a statement, return value: 0 = success */
+static int db_step(struct db *db, sqlite3_stmt *stmt)
+{
+	int rc = sqlite3_step(stmt);
+
+	sqlite3_reset(stmt);
+	if (rc != SQLITE_DONE && rc != SQLITE_ROW)
+	{
+		printf("db: %s: %s\n", sqlite3_sql(stmt), sqlite3_errmsg(db->conn));
+		return 1;
+	}
+	return 0;
+}
+
+/* run a query for a single id, -1 = none or error */
+static long long db_id(struct db *db, sqlite3_stmt *stmt)
+{
+	long long id = -1;
+
+	if (SQLITE_ROW == sqlite3_step(stmt))
+		id = sqlite3_column_int64(stmt, 0);
+	sqlite3_reset(stmt);
+	return id;
+}
+
+int db_open(struct db *db, char *path)
+{
+	memset(db, 0, sizeof(*db));
+	if (SQLITE_OK != sqlite3_open(path, &db->conn))
+	{
+		printf("db_open: failed to open %s: %s\n", path, sqlite3_errmsg(db->conn));
+		sqlite3_close(db->conn);
+		db->conn = NULL;
+		return 1;
+	}
+	sqlite3_busy_timeout(db->conn, 10000);
+
+	if (0 != db_exec(db,
+		"CREATE TABLE IF NOT EXISTS logger ("
+			"id INTEGER PRIMARY KEY, "
+			"name TEXT NOT NULL UNIQUE);"
+		"CREATE TABLE IF NOT EXISTS session ("
+			"id INTEGER PRIMARY KEY, "
+			"logger INTEGER NOT NULL REFERENCES logger(id), "
+			"start INTEGER NOT NULL, "
+			"interval INTEGER NOT NULL, "
+			"num_data_conf INTEGER NOT NULL, "
+			"num_data_rec INTEGER NOT NULL, "
+			"fahrenheit INTEGER, "
+			"thresh_temp_low INTEGER, "
+			"thresh_temp_high INTEGER, "
+			"thresh_rh_low INTEGER, "
+			"thresh_rh_high INTEGER, "
+			"UNIQUE (logger, start));"
+		"CREATE TABLE IF NOT EXISTS sample ("
+			"logger INTEGER NOT NULL REFERENCES logger(id), "
+			"time INTEGER NOT NULL, "
+			"session INTEGER NOT NULL REFERENCES session(id), "
+			"temp REAL NOT NULL, "
+			"rh REAL NOT NULL, "
+			"PRIMARY KEY (logger, time)) WITHOUT ROWID;") ||
+		0 != db_prepare(db, "INSERT OR IGNORE INTO logger (name) VALUES (?)", &db->logger_ins) ||
+		0 != db_prepare(db, "SELECT id FROM logger WHERE name = ?", &db->logger_sel) ||
+		0 != db_prepare(db,
+			"INSERT INTO session (logger, start, interval, num_data_conf, num_data_rec, fahrenheit, "
+				"thresh_temp_low, thresh_temp_high, thresh_rh_low, thresh_rh_high) "
+			"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?) "
+			"ON CONFLICT (logger, start) DO UPDATE SET "
+				"num_data_rec = max(num_data_rec, excluded.num_data_rec), "
+				"fahrenheit = coalesce(excluded.fahrenheit, fahrenheit), "
+				"thresh_temp_low = coalesce(excluded.thresh_temp_low, thresh_temp_low), "
+				"thresh_temp_high = coalesce(excluded.thresh_temp_high, thresh_temp_high), "
+				"thresh_rh_low = coalesce(excluded.thresh_rh_low, thresh_rh_low), "
+				"thresh_rh_high = coalesce(excluded.thresh_rh_high, thresh_rh_high)",
+			&db->session_ins) ||
+		0 != db_prepare(db, "SELECT id FROM session WHERE logger = ? AND start = ?", &db->session_sel) ||
+		0 != db_prepare(db, "INSERT OR IGNORE INTO sample (logger, time, session, temp, rh) VALUES (?, ?, ?, ?, ?)",
+			&db->sample_ins) ||
+		0 != db_exec(db, "BEGIN"))
+	{
+		db_close(db);
+		return 1;
+	}
+	return 0;
+}
+
+/* start a session, the samples of the following db_add belong to it */
+int db_session(
+	struct db *db,
+	char *name,                     /* logger name */
+	struct config *cfg,             /* start time, interval, number of data */
+	int from_logger                 /* bool: cfg was read from the logger, has unit and thresholds */
+) {
+	struct tm time_start;
+	long long start;
+
+	sqlite3_bind_text(db->logger_ins, 1, name, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text(db->logger_sel, 1, name, -1, SQLITE_TRANSIENT);
+	if (0 != db_step(db, db->logger_ins) || (db->logger = db_id(db, db->logger_sel)) < 0)
+		return 1;
+
+	/* as config_start_time, data times are the local time taken as UTC */
+	memset(&time_start, 0, sizeof(time_start));
+	time_start.tm_year = -1900 + config_time_year(cfg);
+	time_start.tm_mon  = -1 + config_time_mon(cfg);
+	time_start.tm_mday = config_time_mday(cfg);
+	time_start.tm_hour = config_time_hour(cfg);
+	time_start.tm_min  = config_time_min(cfg);
+	time_start.tm_sec  = config_time_sec(cfg);
+	start = timegm(&time_start);
+
+	sqlite3_bind_int64(db->session_ins, 1, db->logger);
+	sqlite3_bind_int64(db->session_ins, 2, start);
+	sqlite3_bind_int(db->session_ins, 3, config_interval(cfg));
+	sqlite3_bind_int(db->session_ins, 4, config_num_data_conf(cfg));
+	sqlite3_bind_int(db->session_ins, 5, config_num_data_rec(cfg));
+	if (from_logger)
+	{
+		sqlite3_bind_int(db->session_ins, 6, config_temp_is_fahrenheit(cfg) ? 1 : 0);
+		sqlite3_bind_int(db->session_ins, 7, config_thresh_temp_low(cfg));
+		sqlite3_bind_int(db->session_ins, 8, config_thresh_temp_high(cfg));
+		sqlite3_bind_int(db->session_ins, 9, config_thresh_rh_low(cfg));
+		sqlite3_bind_int(db->session_ins, 10, config_thresh_rh_high(cfg));
+	}
+	else
+	{
+		sqlite3_bind_null(db->session_ins, 6);
+		sqlite3_bind_null(db->session_ins, 7);
+		sqlite3_bind_null(db->session_ins, 8);
+		sqlite3_bind_null(db->session_ins, 9);
+		sqlite3_bind_null(db->session_ins, 10);
+	}
+	sqlite3_bind_int64(db->session_sel, 1, db->logger);
+	sqlite3_bind_int64(db->session_sel, 2, start);
+	if (0 != db_step(db, db->session_ins) || (db->session = db_id(db, db->session_sel)) < 0)
+		return 1;
+	return 0;
+}
+
+int db_add(struct db *db, struct data *data_first)
+{
+	struct data *data_curr;
+
+	sqlite3_bind_int64(db->sample_ins, 1, db->logger);
+	sqlite3_bind_int64(db->sample_ins, 3, db->session);
+	for (data_curr = data_first; data_curr != NULL; data_curr = data_curr->next)
+	{
+		sqlite3_bind_int64(db->sample_ins, 2, data_curr->time);
+		sqlite3_bind_double(db->sample_ins, 4, data_curr->temp / 10.0);
+		sqlite3_bind_double(db->sample_ins, 5, data_curr->rh / 10.0);
+		if (0 != db_step(db, db->sample_ins))
+			return 1;
+		db->num_data++;
+
+		/* one journal commit per batch, not per sample */
+		if (++db->batch == DB_BATCH)
+		{
+			if (0 != db_exec(db, "COMMIT") || 0 != db_exec(db, "BEGIN"))
+				return 1;
+			db->batch = 0;
+		}
+	}
+	return 0;
+}
+
+/* commit and close, also after a failed db_open */
+int db_close(struct db *db)
+{
+	int ret = 0;
+
+	if (db->conn == NULL)
+		return 1;
+	if (sqlite3_get_autocommit(db->conn) == 0)
+		ret = db_exec(db, "COMMIT");
+	sqlite3_finalize(db->logger_ins);
+	sqlite3_finalize(db->logger_sel);
+	sqlite3_finalize(db->session_ins);
+	sqlite3_finalize(db->session_sel);
+	sqlite3_finalize(db->sample_ins);
+	if (SQLITE_OK != sqlite3_close(db->conn))
+		ret = 1;
+	db->conn = NULL;
+	return ret;
+}
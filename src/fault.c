@@ -0,0 +1,165 @@
+/* sensor fault detection, one pass over the data points as they come in */
+
+/*
+*  each data point is checked on the values the logger sent, before
+*  calibration, and gets FAULT_* bits in data->fault:
+*
+*   range  outside what the sensor can measure, TEMP_MIN to TEMP_MAX_C
+*          (TEMP_MAX_F) and RH_MIN to RH_MAX
+*   spike  further than FAULT_SPIKE_TEMP / FAULT_SPIKE_RH away from the
+*          median of itself and both neighbours, i.e. a single data point
+*          off while the ones before and after agree. a step is no spike.
+*   stuck  the same value for FAULT_STUCK sec and at least FAULT_STUCK_MIN
+*          data points, tagged from there until the value changes
+*
+*  the state is the last two data points and the current runs, so each
+*  data point costs O(1). a spike is only known with the data point after
+*  it, store_point writes each line one data point late for that.
+*
+*  the archive tags suspect lines with a comment, e.g. '... # temp:spike',
+*  and the trailer of a session with suspect data points sums them up,
+*  see archive.c.
+*/
+
+#define FAULT_TEMP_RANGE 0x01
+#define FAULT_RH_RANGE   0x02
+#define FAULT_TEMP_SPIKE 0x04
+#define FAULT_RH_SPIKE   0x08
+#define FAULT_TEMP_STUCK 0x10
+#define FAULT_RH_STUCK   0x20
+
+#define FAULT_SPIKE_TEMP 50    /* tenths of °C, 9/5 of it in °F */
+#define FAULT_SPIKE_RH 150     /* tenths of % */
+#define FAULT_STUCK 43200      /* sec */
+#define FAULT_STUCK_MIN 10     /* data points */
+
+struct fault_channel {
+	int spike;                      /* limit, tenths */
+	int min, max;                   /* range, tenths */
+	int run;                        /* data points with the current value */
+	long long run_start;            /* time of the first one */
+	int num_range;                  /* data points tagged */
+	int num_spike;
+	int num_stuck;
+};
+
+struct fault {
+	struct data *prev2, *prev1;     /* the last two data points */
+	struct fault_channel temp;
+	struct fault_channel rh;
+	int num_suspect;                /* data points with any tag */
+};
+
+void fault_init(struct fault *f, int fahrenheit);
+void fault_add(struct fault *f, struct data *data_curr);
+void fault_end(struct fault *f);
+int fault_summary(struct fault *f, char *buf, int size);
+char *fault_tags(int fault, char *buf, int size);
+
+
+void fault_init(struct fault *f, int fahrenheit)
+{
+	memset(f, 0, sizeof(*f));
+	f->temp.spike = fahrenheit ? FAULT_SPIKE_TEMP * 9 / 5 : FAULT_SPIKE_TEMP;
+	f->temp.min = TEMP_MIN * 10;
+	f->temp.max = (fahrenheit ? TEMP_MAX_F : TEMP_MAX_C) * 10;
+	f->rh.spike = FAULT_SPIKE_RH;
+	f->rh.min = RH_MIN * 10;
+	f->rh.max = RH_MAX * 10;
+}
+
+static int fault_median(int a, int b, int c)
+{
+	if (a > b) { int t = a; a = b; b = t; }
+	if (b > c) b = c;
+	return a > b ? a : b;
+}
+
+/* check one channel: value of the new data point, prev1 and prev2 of the */
+/* ones before, n of them known; returns the bits of the new data point */
+/* and sets *spike if prev1 is a spike */
+static int fault_check(struct fault_channel *ch, int n, int prev2, int prev1, int value,
+	long long time, int range, int spike_bit, int stuck, int *spike)
+{
+	int fault = 0;
+
+	if (value < ch->min || ch->max < value)
+	{
+		fault |= range;
+		ch->num_range++;
+	}
+
+	if (n >= 2 && abs(prev1 - fault_median(prev2, prev1, value)) > ch->spike)
+	{
+		*spike |= spike_bit;
+		ch->num_spike++;
+	}
+
+	if (n >= 1 && value == prev1)
+		ch->run++;
+	else
+	{
+		ch->run = 1;
+		ch->run_start = time;
+	}
+	if (ch->run >= FAULT_STUCK_MIN && time - ch->run_start >= FAULT_STUCK)
+	{
+		fault |= stuck;
+		ch->num_stuck++;
+	}
+	return fault;
+}
+
+void fault_add(struct fault *f, struct data *data_curr)
+{
+	int n = f->prev2 ? 2 : f->prev1 ? 1 : 0;
+	int spike = 0;
+
+	data_curr->fault = 0;
+	data_curr->fault |= fault_check(&f->temp, n,
+		n >= 2 ? f->prev2->temp_raw : 0, n >= 1 ? f->prev1->temp_raw : 0, data_curr->temp_raw,
+		data_curr->time, FAULT_TEMP_RANGE, FAULT_TEMP_SPIKE, FAULT_TEMP_STUCK, &spike);
+	data_curr->fault |= fault_check(&f->rh, n,
+		n >= 2 ? f->prev2->rh_raw : 0, n >= 1 ? f->prev1->rh_raw : 0, data_curr->rh_raw,
+		data_curr->time, FAULT_RH_RANGE, FAULT_RH_SPIKE, FAULT_RH_STUCK, &spike);
+
+	/* prev1 is final now */
+	if (n >= 1)
+	{
+		f->prev1->fault |= spike;
+		if (f->prev1->fault)
+			f->num_suspect++;
+	}
+	f->prev2 = f->prev1;
+	f->prev1 = data_curr;
+}
+
+/* no more data points, the last one is final */
+void fault_end(struct fault *f)
+{
+	if (f->prev1 != NULL && f->prev1->fault)
+		f->num_suspect++;
+	f->prev1 = f->prev2 = NULL;
+}
+
+/* the summary of the session, return value: number of suspect data points */
+int fault_summary(struct fault *f, char *buf, int size)
+{
+	snprintf(buf, size, "%i suspect: temp %i range %i spike %i stuck, rh %i range %i spike %i stuck",
+		f->num_suspect, f->temp.num_range, f->temp.num_spike, f->temp.num_stuck,
+		f->rh.num_range, f->rh.num_spike, f->rh.num_stuck);
+	return f->num_suspect;
+}
+
+/* the tags of a data point, e.g. "temp:spike rh:stuck" */
+char *fault_tags(int fault, char *buf, int size)
+{
+	static char *names[] = { "temp:range", "rh:range", "temp:spike", "rh:spike", "temp:stuck", "rh:stuck" };
+	int i, len = 0;
+
+	buf[0] = '\0';
+	for (i = 0; i < 6; i++)
+		if (fault & (1 << i))
+			len += snprintf(buf + len, size - len, "%s%s", len ? " " : "", names[i]);
+	return buf;
+}
@@ -0,0 +1,129 @@
+/* write gnuplot binary data files and a plot script for them */
+
+/*
+*  FILE.bin holds one 12 byte record per data point, little endian:
+*
+*   time  int32  like print_data, local time taken as UTC
+*   temp  float  temperature in °C or °F
+*   rh    float  relative humidity in %
+*
+*  FILE.plt plots it like doc/messung.plt, reading the records with
+*  binary format="%int32%float%float", so gnuplot skips parsing text.
+*  gnuplot 5 is needed, older versions count time from 2000.
+*/
+
+#define GNUPLOT_FORMAT "%int32%float%float"
+#define GNUPLOT_RECORD 12
+#define GNUPLOT_BUF (1024 * GNUPLOT_RECORD)
+
+struct gnuplot_file {
+	FILE *bin;
+	char path[1024];           /* without .bin or .plt */
+	long long num_data;
+	unsigned char buf[GNUPLOT_BUF];
+	int len;
+};
+
+int gnuplot_open(struct gnuplot_file *gf, char *path);
+int gnuplot_add(struct gnuplot_file *gf, long long time, float temp, float rh);
+int gnuplot_close(struct gnuplot_file *gf, char *title);
+
+
+int gnuplot_open(struct gnuplot_file *gf, char *path)
+{
+	char bin_path[1040];
+
+	memset(gf, 0, sizeof(*gf));
+	snprintf(gf->path, sizeof(gf->path), "%s", path);
+	snprintf(bin_path, sizeof(bin_path), "%s.bin", gf->path);
+	gf->bin = fopen(bin_path, "w");
+	if (gf->bin == NULL)
+	{
+		printf("gnuplot_open: failed to fopen(\"%s\", \"w\")\n", bin_path);
+		return 1;
+	}
+	return 0;
+}
+
+static int gnuplot_flush(struct gnuplot_file *gf)
+{
+	if (gf->len > 0 && fwrite(gf->buf, 1, gf->len, gf->bin) != gf->len)
+	{
+		printf("gnuplot_flush: failed to write %s.bin\n", gf->path);
+		return 1;
+	}
+	gf->len = 0;
+	return 0;
+}
+
+int gnuplot_add(struct gnuplot_file *gf, long long time, float temp, float rh)
+{
+	uint32_t u[3];
+
+	u[0] = htole32((int32_t)time);
+	memcpy(&u[1], &temp, 4);
+	memcpy(&u[2], &rh, 4);
+	u[1] = htole32(u[1]);
+	u[2] = htole32(u[2]);
+	memcpy(gf->buf + gf->len, u, GNUPLOT_RECORD);
+	gf->len += GNUPLOT_RECORD;
+	gf->num_data++;
+	if (gf->len == GNUPLOT_BUF)
+		return gnuplot_flush(gf);
+	return 0;
+}
+
+/* finish FILE.bin and write FILE.plt */
+int gnuplot_close(struct gnuplot_file *gf, char *title)
+{
+	char plt_path[1040];
+	FILE *plt;
+	int ret;
+
+	ret = gnuplot_flush(gf);
+	if (0 != fclose(gf->bin))
+		ret = 1;
+	if (ret != 0)
+		return 1;
+
+	snprintf(plt_path, sizeof(plt_path), "%s.plt", gf->path);
+	plt = fopen(plt_path, "w");
+	if (plt == NULL)
+	{
+		printf("gnuplot_close: failed to fopen(\"%s\", \"w\")\n", plt_path);
+		return 1;
+	}
+	fprintf(plt,
+		"#!/usr/bin/gnuplot -persist\n"
+		"\n"
+		"# %lli data points, written by vdl120\n"
+		"\n"
+		"# Ausgabe in PNG Datei\n"
+		"#set terminal png nocrop enhanced font \"/usr/share/fonts/corefonts/verdana.ttf\" 10 size 800,600\n"
+		"#set output '%s.png'\n"
+		"\n"
+		"set title \"%s\"\n"
+		"set xdata time\n"
+		"set timefmt \"%%s\"\n"
+		"set format x \"%%d.%%m.%%Y %%H:%%M\"\n"
+		"set xtics nomirror rotate by -60\n"
+		"set grid\n"
+		"\n"
+		"bin = '%s.bin'\n"
+		"fmt = '%s'\n"
+		"\n"
+		"plot bin binary format=fmt endian=little using 1:2 with points lt 1 title \"Temp / °C\", \\\n"
+		"     bin binary format=fmt endian=little using 1:3 with points lt 2 title \"RLF / %%\"\n"
+		"\n"
+		"# Darstellung des 24h-Verlaufs\n"
+		"#set format x \"%%H:%%M\"\n"
+		"#plot bin binary format=fmt endian=little using (int($1) %% 86400):2 with dots lt 1 title \"Temp / °C\", \\\n"
+		"#     bin binary format=fmt endian=little using (int($1) %% 86400):3 with dots lt 2 title \"RLF / %%\"\n",
+		gf->num_data, gf->path, title, gf->path, GNUPLOT_FORMAT);
+	if (0 != fclose(plt))
+	{
+		printf("gnuplot_close: failed to write %s\n", plt_path);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,303 @@
+/* histogram sketches of the stored data, for percentiles and bands */
+
+/*
+*  store_data keeps LOGNAME.hist next to LOGNAME.dat. it holds one record
+*  per session and day with the number of data points per 0.1 unit bin,
+*  i.e. per value the logger can send. adding up the bins of any records
+*  gives the exact histogram of their data, so percentiles and the time
+*  spent in a band over months of several loggers only need these files,
+*  never the data itself.
+*
+*  a data point stands for one interval of its session, so the queries
+*  weight the bins with it: percentiles and bands are shares of time.
+*  days are those of the data's time stamps (local time), query ranges are
+*  whole days.
+*
+*  record, little endian:
+*
+*   0   "VDLH"
+*   4   u32  size of the record in bytes
+*   8   u64  time of the first data point
+*   16  u64  time of the last data point
+*   24  u32  number of data points
+*   28  u32  interval in seconds
+*   32  s16  lowest temp bin, s16 highest temp bin (tenths)
+*   36  s16  lowest rh bin, s16 highest rh bin
+*   40  u8   1 = temp in °F, 3 bytes unused
+*   44  u32  count per temp bin, then count per rh bin
+*
+*  a record cut short by a crash ends the file for the readers, and is
+*  cut off by hist_recover before the next record is appended. it also
+*  returns the time of the last data point of the last record, so
+*  store_data can tell whether the file still matches LOGNAME.dat.
+*/
+
+#define HIST_MAGIC "VDLH"
+#define HIST_HEADER 44
+#define HIST_BINS 65536 /* every short int value */
+#define HIST_DAY 86400
+
+struct hist {
+	unsigned long long *temp;       /* seconds per bin, index value + 32768 */
+	unsigned long long *rh;
+	unsigned long long total;       /* seconds */
+	long long num_data;
+	long long time_first, time_last;
+	int num_records;
+	int fahrenheit;                 /* -1 = no data yet */
+};
+
+int hist_write(FILE *file, struct data *data_first, int interval, int fahrenheit);
+int hist_init(struct hist *h);
+int hist_read(struct hist *h, char *path, long long from, long long to);
+int hist_recover(char *path, int *cut, long long *time_last);
+int hist_percentile(unsigned long long *bins, unsigned long long total, double p);
+unsigned long long hist_band(unsigned long long *bins, int low, int high);
+void hist_free(struct hist *h);
+
+
+static void hist_put32(unsigned char *p, unsigned int value)
+{
+	p[0] = value & 0xFF;
+	p[1] = (value >> 8) & 0xFF;
+	p[2] = (value >> 16) & 0xFF;
+	p[3] = (value >> 24) & 0xFF;
+}
+
+static unsigned int hist_get32(unsigned char *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+static long long hist_day(long long time)
+{
+	return time >= 0 ? time / HIST_DAY : (time - HIST_DAY + 1) / HIST_DAY;
+}
+
+/* write the records of one session, split at midnight */
+int hist_write(FILE *file, struct data *data_first, int interval, int fahrenheit)
+{
+	struct data *day_first, *day_end, *data_curr;
+	unsigned char *rec;
+	int temp_lo, temp_hi, rh_lo, rh_hi, num_data, size, i;
+
+	for (day_first = data_first; day_first != NULL; day_first = day_end)
+	{
+		temp_lo = temp_hi = day_first->temp;
+		rh_lo = rh_hi = day_first->rh;
+		num_data = 0;
+		for (day_end = day_first; day_end != NULL &&
+			hist_day(day_end->time) == hist_day(day_first->time); day_end = day_end->next)
+		{
+			if (day_end->temp < temp_lo) temp_lo = day_end->temp;
+			if (day_end->temp > temp_hi) temp_hi = day_end->temp;
+			if (day_end->rh < rh_lo) rh_lo = day_end->rh;
+			if (day_end->rh > rh_hi) rh_hi = day_end->rh;
+			num_data++;
+		}
+
+		size = HIST_HEADER + 4 * (temp_hi - temp_lo + 1 + rh_hi - rh_lo + 1);
+		rec = calloc(1, size);
+		if (rec == NULL)
+			return 1;
+		memcpy(rec, HIST_MAGIC, 4);
+		hist_put32(rec + 4, size);
+		hist_put32(rec + 8, (unsigned long long)day_first->time & 0xFFFFFFFF);
+		hist_put32(rec + 12, (unsigned long long)day_first->time >> 32);
+		for (data_curr = day_first; data_curr->next != day_end; data_curr = data_curr->next)
+			;
+		hist_put32(rec + 16, (unsigned long long)data_curr->time & 0xFFFFFFFF);
+		hist_put32(rec + 20, (unsigned long long)data_curr->time >> 32);
+		hist_put32(rec + 24, num_data);
+		hist_put32(rec + 28, interval);
+		hist_put32(rec + 32, (temp_lo & 0xFFFF) | (temp_hi & 0xFFFF) << 16);
+		hist_put32(rec + 36, (rh_lo & 0xFFFF) | (rh_hi & 0xFFFF) << 16);
+		rec[40] = fahrenheit ? 1 : 0;
+
+		for (data_curr = day_first; data_curr != day_end; data_curr = data_curr->next)
+		{
+			i = HIST_HEADER + 4 * (data_curr->temp - temp_lo);
+			hist_put32(rec + i, hist_get32(rec + i) + 1);
+			i = HIST_HEADER + 4 * (temp_hi - temp_lo + 1 + data_curr->rh - rh_lo);
+			hist_put32(rec + i, hist_get32(rec + i) + 1);
+		}
+
+		i = fwrite(rec, size, 1, file);
+		free(rec);
+		if (i != 1)
+			return 1;
+	}
+	return 0;
+}
+
+int hist_init(struct hist *h)
+{
+	memset(h, 0, sizeof(*h));
+	h->fahrenheit = -1;
+	h->temp = calloc(HIST_BINS, sizeof(unsigned long long));
+	h->rh = calloc(HIST_BINS, sizeof(unsigned long long));
+	if (h->temp == NULL || h->rh == NULL)
+	{
+		hist_free(h);
+		return 1;
+	}
+	return 0;
+}
+
+/* add the records of days from .. to-1 to h, -1 = open end */
+int hist_read(struct hist *h, char *path, long long from, long long to)
+{
+	FILE *file;
+	unsigned char head[HIST_HEADER], *bins = NULL;
+	long long time_first, time_last;
+	unsigned int size, num_data, interval;
+	int temp_lo, temp_hi, rh_lo, rh_hi, i, ret = 0;
+
+	file = fopen(path, "r");
+	if (file == NULL)
+	{
+		printf("hist_read: failed to fopen(\"%s\", \"r\")\n", path);
+		return 1;
+	}
+
+	while (1 == fread(head, HIST_HEADER, 1, file))
+	{
+		size = hist_get32(head + 4);
+		time_first = hist_get32(head + 8) | (long long)hist_get32(head + 12) << 32;
+		time_last = hist_get32(head + 16) | (long long)hist_get32(head + 20) << 32;
+		num_data = hist_get32(head + 24);
+		interval = hist_get32(head + 28);
+		temp_lo = (short int)(head[32] | head[33] << 8);
+		temp_hi = (short int)(head[34] | head[35] << 8);
+		rh_lo = (short int)(head[36] | head[37] << 8);
+		rh_hi = (short int)(head[38] | head[39] << 8);
+
+		if (0 != memcmp(head, HIST_MAGIC, 4) || temp_hi < temp_lo || rh_hi < rh_lo ||
+			size != HIST_HEADER + 4 * (temp_hi - temp_lo + 1 + rh_hi - rh_lo + 1))
+		{
+			printf("hist_read: %s: invalid record at %li\n", path, ftell(file) - HIST_HEADER);
+			ret = 1;
+			break;
+		}
+
+		if ((from >= 0 && hist_day(time_first) < hist_day(from)) ||
+			(to >= 0 && hist_day(time_last) >= hist_day(to)))
+		{
+			if (0 != fseek(file, size - HIST_HEADER, SEEK_CUR))
+				break;
+			continue;
+		}
+
+		if (h->fahrenheit >= 0 && h->fahrenheit != (head[40] & 1))
+		{
+			printf("hist_read: %s: cannot mix °C and °F\n", path);
+			ret = 1;
+			break;
+		}
+		h->fahrenheit = head[40] & 1;
+
+		bins = realloc(bins, size - HIST_HEADER);
+		if (1 != fread(bins, size - HIST_HEADER, 1, file))
+			break; /* torn tail */
+
+		for (i = temp_lo; i <= temp_hi; i++)
+			h->temp[i + 32768] += (unsigned long long)hist_get32(bins + 4 * (i - temp_lo)) * interval;
+		for (i = rh_lo; i <= rh_hi; i++)
+			h->rh[i + 32768] += (unsigned long long)hist_get32(bins + 4 * (temp_hi - temp_lo + 1 + i - rh_lo)) * interval;
+
+		if (h->num_records == 0 || time_first < h->time_first)
+			h->time_first = time_first;
+		if (h->num_records == 0 || time_last > h->time_last)
+			h->time_last = time_last;
+		h->total += (unsigned long long)num_data * interval;
+		h->num_data += num_data;
+		h->num_records++;
+	}
+
+	free(bins);
+	fclose(file);
+	return ret;
+}
+
+/* cut a record torn by a crash off the end, before appending, */
+/* *time_last gets the last time of the last whole record, -1 = none */
+/* return value: 0 = file is fine now */
+int hist_recover(char *path, int *cut, long long *time_last)
+{
+	unsigned char head[HIST_HEADER];
+	unsigned int size;
+	long long end, pos = 0;
+	int fd, ret = 0;
+
+	*cut = 0;
+	*time_last = -1;
+	fd = open(path, O_RDWR);
+	if (fd < 0)
+		return errno == ENOENT ? 0 : 1;
+	end = lseek(fd, 0, SEEK_END);
+	while (pos < end)
+	{
+		if (HIST_HEADER != pread(fd, head, HIST_HEADER, pos) || 0 != memcmp(head, HIST_MAGIC, 4))
+			break;
+		size = hist_get32(head + 4);
+		if (size < HIST_HEADER || pos + size > end)
+			break;
+		*time_last = hist_get32(head + 16) | (long long)hist_get32(head + 20) << 32;
+		pos += size;
+	}
+	if (pos < end)
+	{
+		printf("hist_recover: %s: removing %lli bytes of a torn record\n", path, end - pos);
+		*cut = 1;
+		if (0 != ftruncate(fd, pos) || 0 != fsync(fd))
+		{
+			printf("hist_recover: failed to truncate %s: %s\n", path, strerror(errno));
+			ret = 1;
+		}
+	}
+	close(fd);
+	return ret;
+}
+
+/* smallest value with at least p (0..1) of the time at or below it, in tenths */
+int hist_percentile(unsigned long long *bins, unsigned long long total, double p)
+{
+	unsigned long long sum = 0, need;
+	int i;
+
+	need = p * total;
+	if (need < p * total)
+		need++;
+	if (need < 1)
+		need = 1;
+	for (i = 0; i < HIST_BINS; i++)
+	{
+		sum += bins[i];
+		if (sum >= need)
+			break;
+	}
+	return i - 32768;
+}
+
+/* seconds with low <= value <= high, in tenths */
+unsigned long long hist_band(unsigned long long *bins, int low, int high)
+{
+	unsigned long long sum = 0;
+	int i;
+
+	if (low < -32768)
+		low = -32768;
+	if (high > 32767)
+		high = 32767;
+	for (i = low; i <= high; i++)
+		sum += bins[i + 32768];
+	return sum;
+}
+
+void hist_free(struct hist *h)
+{
+	free(h->temp);
+	free(h->rh);
+	h->temp = NULL;
+	h->rh = NULL;
+}
@@ -0,0 +1,386 @@
+/* send data as InfluxDB line protocol, in batches */
+
+/*
+*  one line per data point:
+*
+*   vdl120,logger=NAME,temp_unit=°C,rh_unit=% temp=21.3,rh=50.1 TIME
+*
+*  TIME in nanoseconds, UTC. with -K the fields temp_raw and rh_raw are
+*  added. the lines are collected into batches, which are sent when they
+*  reach the batch size, when the flush interval has passed since the
+*  first line of the batch, or at exit.
+*
+*  the target is either a spool directory or a unix stream socket,
+*  "unix:PATH", e.g. of telegraf's socket_listener.
+*
+*  spool directory: each batch is written to a hidden temporary file,
+*  synced and renamed to TIME-PID-SEQ.lp, so readers only ever see
+*  complete batches. after a batch, NAME.last records the newest time
+*  spooled per logger, the same way; data points up to that time are
+*  skipped, so after a crash or restart the next download resumes where
+*  the spool stopped. leftover temporary files of a crash are removed at
+*  start, their data points are spooled again.
+*/
+
+#define INFLUX_MEASUREMENT "vdl120"
+
+struct influx_logger {
+	char name[17];
+	long long last;                 /* newest time spooled, unix time as in struct data */
+	long long pending;              /* newest time in the current batch */
+	struct influx_logger *next;
+};
+
+struct influx {
+	char target[1024];
+	int is_socket;
+	int batch_size;                 /* lines per batch */
+	int flush_interval;             /* seconds */
+	char *buf;
+	size_t len, cap;
+	int num_lines;
+	long long batch_start;          /* monotonic seconds of the first line */
+	unsigned int seq;
+	struct influx_logger *loggers;
+	pthread_mutex_t lock;           /* fleet and hotplug workers share it */
+};
+
+struct influx *influx = NULL; /* set by -I */
+
+int influx_open(char *target, int batch_size, int flush_interval);
+int influx_add(struct config *cfg, struct data *data_first);
+int influx_flush(void);
+void influx_close(void);
+
+
+long long influx_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec;
+}
+
+/* write a small file crash-safe: temporary file, fsync, rename, fsync dir */
+int influx_commit(char *data, size_t len, char *name)
+{
+	char tmp_path[1200], path[1100];
+	int fd, dir;
+	size_t done;
+	ssize_t ret;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s/.tmp-%i-%s", influx->target, (int)getpid(), name);
+	snprintf(path, sizeof(path), "%s/%s", influx->target, name);
+
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		printf("influx_commit: failed to open %s: %s\n", tmp_path, strerror(errno));
+		return 1;
+	}
+	for (done = 0; done < len; done += ret)
+	{
+		ret = write(fd, data + done, len - done);
+		if (ret < 0 && errno == EINTR)
+			ret = 0;
+		else if (ret < 0)
+			break;
+	}
+	if (done < len || fsync(fd) != 0)
+	{
+		printf("influx_commit: failed to write %s: %s\n", tmp_path, strerror(errno));
+		close(fd);
+		unlink(tmp_path);
+		return 1;
+	}
+	close(fd);
+
+	if (rename(tmp_path, path) != 0)
+	{
+		printf("influx_commit: failed to rename %s: %s\n", tmp_path, strerror(errno));
+		unlink(tmp_path);
+		return 1;
+	}
+
+	/* make the rename itself durable */
+	dir = open(influx->target, O_RDONLY | O_DIRECTORY);
+	if (dir >= 0)
+	{
+		fsync(dir);
+		close(dir);
+	}
+	return 0;
+}
+
+struct influx_logger *influx_logger(char *name)
+{
+	struct influx_logger *l;
+	char path[1100], file[64], *pos;
+	FILE *f;
+
+	for (l = influx->loggers; l != NULL; l = l->next)
+		if (0 == strncmp(l->name, name, 16))
+			return l;
+
+	l = calloc(1, sizeof(struct influx_logger));
+	snprintf(l->name, sizeof(l->name), "%.16s", name);
+	l->last = -1;
+	l->pending = -1;
+	l->next = influx->loggers;
+	influx->loggers = l;
+
+	/* resume after the last spooled data point */
+	if (!influx->is_socket)
+	{
+		snprintf(file, sizeof(file), "%s.last", l->name);
+		for (pos = file; *pos; pos++)
+			if (*pos == '/')
+				*pos = '_';
+		snprintf(path, sizeof(path), "%s/%s", influx->target, file);
+		f = fopen(path, "r");
+		if (f != NULL)
+		{
+			if (1 != fscanf(f, "%lld", &l->last))
+				l->last = -1;
+			fclose(f);
+		}
+	}
+	return l;
+}
+
+int influx_open(char *target, int batch_size, int flush_interval)
+{
+	DIR *dir;
+	struct dirent *entry;
+	char path[1400];
+
+	influx = calloc(1, sizeof(struct influx));
+	if (influx == NULL)
+		return 1;
+	if (0 == strncmp(target, "unix:", 5))
+	{
+		if (strlen(target + 5) >= sizeof(((struct sockaddr_un *)0)->sun_path))
+		{
+			printf("influx_open: socket path too long: %s\n", target + 5);
+			free(influx);
+			influx = NULL;
+			return 1;
+		}
+		influx->is_socket = 1;
+		snprintf(influx->target, sizeof(influx->target), "%s", target + 5);
+	}
+	else
+		snprintf(influx->target, sizeof(influx->target), "%s", target);
+	influx->batch_size = batch_size > 0 ? batch_size : 16000;
+	influx->flush_interval = flush_interval > 0 ? flush_interval : 0;
+	pthread_mutex_init(&influx->lock, NULL);
+
+	if (influx->is_socket)
+		return 0;
+
+	/* remove batches a crash left half written */
+	dir = opendir(influx->target);
+	if (dir == NULL)
+	{
+		printf("influx_open: failed to open spool directory %s: %s\n", influx->target, strerror(errno));
+		free(influx);
+		influx = NULL;
+		return 1;
+	}
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (0 != strncmp(entry->d_name, ".tmp-", 5))
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", influx->target, entry->d_name);
+		unlink(path);
+	}
+	closedir(dir);
+	return 0;
+}
+
+/* escape commas, spaces and equal signs of a tag value */
+void influx_tag(char *out, size_t size, char *value, size_t len)
+{
+	size_t i, n = 0;
+
+	for (i = 0; i < len && value[i] != 0 && n + 2 < size; i++)
+	{
+		if (value[i] == ',' || value[i] == ' ' || value[i] == '=')
+			out[n++] = '\\';
+		out[n++] = value[i];
+	}
+	out[n] = 0;
+}
+
+int influx_add(struct config *cfg, struct data *data_first)
+{
+	struct influx_logger *l;
+	struct data *data_curr;
+	struct tm tm;
+	char name[40], tags[128];
+	long long utc;
+	int ret = 0, n;
+
+	if (influx == NULL)
+		return 0;
+
+	pthread_mutex_lock(&influx->lock);
+
+	l = influx_logger(config_name(cfg));
+	influx_tag(name, sizeof(name), config_name(cfg), 16);
+	snprintf(tags, sizeof(tags), INFLUX_MEASUREMENT ",logger=%s,temp_unit=%s,rh_unit=%%",
+		name, config_temp_is_fahrenheit(cfg) ? "°F" : "°C");
+
+	for (data_curr = data_first; data_curr != NULL; data_curr = data_curr->next)
+	{
+		if (data_curr->time <= l->last || data_curr->time <= l->pending)
+			continue;
+
+		if (influx->num_lines == 0)
+			influx->batch_start = influx_now();
+
+		if (influx->cap - influx->len < 256)
+		{
+			influx->cap = influx->cap ? influx->cap * 2 : 65536;
+			influx->buf = realloc(influx->buf, influx->cap);
+		}
+
+		/* data time is the local wall clock, make it real UTC */
+		gmtime_r(&data_curr->time, &tm);
+		tm.tm_isdst = -1;
+		utc = mktime(&tm);
+
+		n = snprintf(influx->buf + influx->len, influx->cap - influx->len, "%s temp=%.1f,rh=%.1f",
+			tags, data_curr->temp/10.0, data_curr->rh/10.0);
+		if (calib_keep_raw)
+			n += snprintf(influx->buf + influx->len + n, influx->cap - influx->len - n, ",temp_raw=%.1f,rh_raw=%.1f",
+				data_curr->temp_raw/10.0, data_curr->rh_raw/10.0);
+		n += snprintf(influx->buf + influx->len + n, influx->cap - influx->len - n, " %lld000000000\n", utc);
+		influx->len += n;
+		influx->num_lines++;
+		l->pending = data_curr->time;
+
+		if (influx->num_lines >= influx->batch_size)
+		{
+			pthread_mutex_unlock(&influx->lock);
+			ret |= influx_flush();
+			pthread_mutex_lock(&influx->lock);
+		}
+	}
+
+	n = influx->num_lines > 0 && influx->flush_interval > 0 &&
+		influx_now() - influx->batch_start >= influx->flush_interval;
+	pthread_mutex_unlock(&influx->lock);
+
+	if (n)
+		ret |= influx_flush();
+	return ret;
+}
+
+int influx_send(void)
+{
+	struct sockaddr_un addr;
+	size_t done;
+	ssize_t ret;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		printf("influx_send: failed to open socket: %s\n", strerror(errno));
+		return 1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, influx->target); /* length checked by influx_open */
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		printf("influx_send: failed to connect to %s: %s\n", influx->target, strerror(errno));
+		close(fd);
+		return 1;
+	}
+	for (done = 0; done < influx->len; done += ret)
+	{
+		ret = send(fd, influx->buf + done, influx->len - done, MSG_NOSIGNAL);
+		if (ret < 0 && errno == EINTR)
+			ret = 0;
+		else if (ret < 0)
+		{
+			printf("influx_send: failed to send to %s: %s\n", influx->target, strerror(errno));
+			close(fd);
+			return 1;
+		}
+	}
+	close(fd);
+	return 0;
+}
+
+int influx_flush(void)
+{
+	struct influx_logger *l;
+	char name[64], file[64], last[32], *pos;
+	int ret = 0;
+
+	if (influx == NULL)
+		return 0;
+	pthread_mutex_lock(&influx->lock);
+	if (influx->num_lines == 0)
+	{
+		pthread_mutex_unlock(&influx->lock);
+		return 0;
+	}
+
+	if (influx->is_socket)
+		ret = influx_send();
+	else
+	{
+		snprintf(name, sizeof(name), "%010lld-%05i-%06u.lp", (long long)time(NULL), (int)getpid(), influx->seq++);
+		ret = influx_commit(influx->buf, influx->len, name);
+
+		/* the batch is safe, move the resume points */
+		for (l = influx->loggers; ret == 0 && l != NULL; l = l->next)
+		{
+			if (l->pending <= l->last)
+				continue;
+			snprintf(file, sizeof(file), "%s.last", l->name);
+			for (pos = file; *pos; pos++)
+				if (*pos == '/')
+					*pos = '_';
+			snprintf(last, sizeof(last), "%lld\n", l->pending);
+			ret = influx_commit(last, strlen(last), file);
+		}
+	}
+
+	if (ret == 0)
+	{
+		fprintf(stderr, "influx_flush: sent %i data points to %s\n", influx->num_lines, influx->target);
+		for (l = influx->loggers; l != NULL; l = l->next)
+			if (l->pending > l->last)
+				l->last = l->pending;
+		influx->len = 0;
+		influx->num_lines = 0;
+	}
+	/* else keep the batch, it goes out with the next flush */
+
+	pthread_mutex_unlock(&influx->lock);
+	return ret;
+}
+
+void influx_close(void)
+{
+	struct influx_logger *l;
+
+	if (influx == NULL)
+		return;
+	influx_flush();
+	while (influx->loggers != NULL)
+	{
+		l = influx->loggers->next;
+		free(influx->loggers);
+		influx->loggers = l;
+	}
+	pthread_mutex_destroy(&influx->lock);
+	free(influx->buf);
+	free(influx);
+	influx = NULL;
+}
@@ -0,0 +1,257 @@
+/* align the data of several loggers on a common time grid */
+
+/*
+*  each source is read as a stream and only keeps the two data points
+*  around the current grid time, so memory does not depend on the amount
+*  of data. the grid either has a fixed step, or (step 0) it is the merged
+*  sequence of all timestamps of all sources.
+*
+*  interpolation methods:
+*
+*   nearest  value of the closer data point
+*   linear   linear interpolation between both data points
+*   last     value of the last data point at or before the grid time
+*
+*  a grid time is a gap for a source, printed as "nan", if it lies before
+*  its first or after its last data point, or if more than 1.5 intervals
+*  of data are missing around it.
+*/
+
+#define JOIN_NEAREST 0
+#define JOIN_LINEAR 1
+#define JOIN_LAST 2
+
+struct join_source {
+	char name[64];
+	FILE *file;          /* file written by store_data, or NULL */
+	long long *time;     /* or data in memory */
+	short *temp;
+	short *rh;
+	int num_data;
+	int pos;
+
+	int interval;        /* of the current session */
+	int have;            /* number of valid data points below, 0..2 */
+	int eof;
+	long long t0, t1;    /* data points around the grid time, t0 <= t1 */
+	int temp0, rh0, temp1, rh1;
+	int interval1;
+};
+
+int join_method(char *name);
+int join_next(struct join_source *src, long long *time, int *temp, int *rh);
+int join_sources(struct join_source *src, int num_src, int method, int step, FILE *out);
+
+
+int join_method(char *name)
+{
+	if (0 == strcmp(name, "nearest"))
+		return JOIN_NEAREST;
+	if (0 == strcmp(name, "linear"))
+		return JOIN_LINEAR;
+	if (0 == strcmp(name, "last"))
+		return JOIN_LAST;
+	return -1;
+}
+
+/* read the next data point of a source, return value: 0 = ok, 1 = end of data */
+int join_next(struct join_source *src, long long *time, int *temp, int *rh)
+{
+	char line[256], *pos;
+	double value;
+	int points, interval;
+
+	if (src->file == NULL)
+	{
+		if (src->pos >= src->num_data)
+			return 1;
+		*time = src->time[src->pos];
+		*temp = src->temp[src->pos];
+		*rh   = src->rh[src->pos];
+		src->pos++;
+		return 0;
+	}
+
+	while (fgets(line, sizeof(line), src->file) != NULL)
+	{
+		/* session header, see store_data */
+		if (line[0] == '#')
+		{
+			pos = strchr(line, ']');
+			if (pos != NULL && 2 == sscanf(pos, "] %d points @ %d sec", &points, &interval))
+				src->interval = interval;
+			continue;
+		}
+
+		*time = strtoll(line, &pos, 10);
+		if (pos == line)
+			continue;
+		value = strtod(pos, &pos);
+		*temp = value < 0 ? value * 10 - 0.5 : value * 10 + 0.5;
+		value = strtod(pos, &pos);
+		*rh = value < 0 ? value * 10 - 0.5 : value * 10 + 0.5;
+		return 0;
+	}
+	return 1;
+}
+
+/* move the source forward until t0 <= time <= t1 or the data ends */
+void join_advance(struct join_source *src, long long time)
+{
+	long long t;
+	int temp, rh;
+
+	while (!src->eof && (src->have < 2 || src->t1 < time))
+	{
+		if (join_next(src, &t, &temp, &rh) != 0)
+		{
+			src->eof = 1;
+			break;
+		}
+		/* drop data out of order, e.g. sessions stored twice */
+		if (src->have > 0 && t <= src->t1)
+			continue;
+
+		src->t0 = src->t1;
+		src->temp0 = src->temp1;
+		src->rh0 = src->rh1;
+		src->t1 = t;
+		src->temp1 = temp;
+		src->rh1 = rh;
+		src->interval1 = src->interval;
+		if (src->have < 2)
+			src->have++;
+	}
+}
+
+/* print the value of one source at 'time' */
+void join_value(struct join_source *src, long long time, int method, FILE *out)
+{
+	long long gap;
+	double temp, rh, f;
+
+	/* exact hits */
+	if (src->have >= 1 && src->t1 == time)
+	{
+		fprintf(out, " %.1f %.1f", src->temp1/10.0, src->rh1/10.0);
+		return;
+	}
+	if (src->have >= 2 && src->t0 == time)
+	{
+		fprintf(out, " %.1f %.1f", src->temp0/10.0, src->rh0/10.0);
+		return;
+	}
+	if (src->have < 2 || time < src->t0 || src->t1 < time)
+	{
+		fprintf(out, " nan nan");
+		return;
+	}
+
+	gap = src->interval1 > 0 ? src->interval1 * 3 / 2 : 0;
+	if (gap > 0 && src->t1 - src->t0 > gap)
+	{
+		fprintf(out, " nan nan");
+		return;
+	}
+
+	switch (method)
+	{
+	case JOIN_LINEAR:
+		f = (double)(time - src->t0) / (src->t1 - src->t0);
+		temp = src->temp0 + f * (src->temp1 - src->temp0);
+		rh = src->rh0 + f * (src->rh1 - src->rh0);
+		break;
+	case JOIN_LAST:
+		temp = src->temp0;
+		rh = src->rh0;
+		break;
+	default:
+		if (time - src->t0 <= src->t1 - time)
+		{
+			temp = src->temp0;
+			rh = src->rh0;
+		}
+		else
+		{
+			temp = src->temp1;
+			rh = src->rh1;
+		}
+	}
+	fprintf(out, " %.1f %.1f", temp/10.0, rh/10.0);
+}
+
+int join_sources(struct join_source *src, int num_src, int method, int step, FILE *out)
+{
+	long long time = 0, next;
+	int i, found;
+
+	fprintf(out, "# time");
+	for (i = 0; i < num_src; i++)
+		fprintf(out, " %s.temp %s.rh", src[i].name, src[i].name);
+	fprintf(out, "\n");
+
+	/* prime all sources, the grid starts at the earliest data point */
+	found = 0;
+	for (i = 0; i < num_src; i++)
+	{
+		join_advance(&src[i], -1);
+		if (src[i].have == 0)
+			continue;
+		next = src[i].have == 2 ? src[i].t0 : src[i].t1;
+		if (!found || next < time)
+			time = next;
+		found = 1;
+	}
+	if (!found)
+		return 0;
+	if (step > 0)
+		time = time / step * step;
+
+	while (1)
+	{
+		found = 0;
+		for (i = 0; i < num_src; i++)
+		{
+			join_advance(&src[i], time);
+			if (src[i].have > 0 && src[i].t1 >= time)
+				found = 1;
+		}
+		if (!found)
+			break;
+
+		fprintf(out, "%lli", time);
+		for (i = 0; i < num_src; i++)
+			join_value(&src[i], time, method, out);
+		fprintf(out, "\n");
+
+		if (step > 0)
+		{
+			time += step;
+			continue;
+		}
+
+		/* merge: the next grid time is the smallest later timestamp, */
+		/* t0 of a source that starts later than time is one, too */
+		found = 0;
+		next = time;
+		for (i = 0; i < num_src; i++)
+		{
+			join_advance(&src[i], time + 1);
+			if (src[i].have > 1 && src[i].t0 > time && (!found || src[i].t0 < next))
+			{
+				next = src[i].t0;
+				found = 1;
+			}
+			if (src[i].have > 0 && src[i].t1 > time && (!found || src[i].t1 < next))
+			{
+				next = src[i].t1;
+				found = 1;
+			}
+		}
+		if (!found)
+			break;
+		time = next;
+	}
+
+	return 0;
+}
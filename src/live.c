@@ -0,0 +1,241 @@
+/* the latest readings of all loggers in shared memory, see vdl120shm.h */
+
+/*
+*  -L NAME creates the table, every later poll, publish and failure of a
+*  logger updates its slot. a logger gets the slot of its config name, so
+*  it keeps it when it is plugged in elsewhere. slots are only written
+*  under live_lock, so each seqlock has one writer at a time; readers never
+*  take the lock.
+*/
+
+struct vdl120shm *live = NULL; /* set by -L */
+pthread_mutex_t live_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int live_open(char *name);
+void live_poll(struct config *cfg);
+void live_add(struct config *cfg, struct data *data_first);
+void live_fail(struct config *cfg);
+int live_print(char *name);
+
+
+int live_open(char *name)
+{
+	struct vdl120shm *table;
+	int fd;
+
+	fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+	{
+		printf("live_open: shm_open(\"%s\") failed: %s\n", name, strerror(errno));
+		return 1;
+	}
+	if (ftruncate(fd, sizeof(struct vdl120shm)) != 0)
+	{
+		printf("live_open: failed to size %s: %s\n", name, strerror(errno));
+		close(fd);
+		return 1;
+	}
+	table = mmap(NULL, sizeof(struct vdl120shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (table == MAP_FAILED)
+	{
+		printf("live_open: mmap failed: %s\n", strerror(errno));
+		return 1;
+	}
+
+	/* a fresh table each start, the magic last so readers never map half of it */
+	memset(table, 0, sizeof(struct vdl120shm));
+	table->version = VDL120SHM_VERSION;
+	table->logger_size = sizeof(struct vdl120shm_logger);
+	table->num_loggers = VDL120SHM_LOGGERS;
+	table->pid = getpid();
+	table->started = time(NULL);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(table->magic, VDL120SHM_MAGIC, 8);
+
+	live = table;
+	return 0;
+}
+
+/* seqlock write side: seq odd, then the fields */
+static void live_begin(struct vdl120shm_logger *l)
+{
+	__atomic_store_n(&l->seq, l->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void live_end(struct vdl120shm_logger *l)
+{
+	__atomic_store_n(&l->seq, l->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* slot of the logger, taken on first use, NULL = table full; live_lock held */
+static struct vdl120shm_logger *live_slot(struct config *cfg)
+{
+	struct vdl120shm_logger *l;
+	int i;
+
+	for (i = 0; i < VDL120SHM_LOGGERS; i++)
+	{
+		l = &live->logger[i];
+		if (l->used && 0 == strncmp(l->name, config_name(cfg), 16))
+			return l;
+	}
+	for (i = 0; i < VDL120SHM_LOGGERS; i++)
+	{
+		l = &live->logger[i];
+		if (!l->used)
+		{
+			live_begin(l);
+			strncpy(l->name, config_name(cfg), 16);
+			l->used = 1;
+			live_end(l);
+			return l;
+		}
+	}
+	return NULL;
+}
+
+static void live_config(struct vdl120shm_logger *l, struct config *cfg)
+{
+	struct tm time_start;
+
+	memcpy(l->config, cfg->buf, CONFIG_SIZE);
+	snprintf(l->location, sizeof(l->location), "%s", logger_location);
+
+	/* as config_start_time */
+	memset(&time_start, 0, sizeof(time_start));
+	time_start.tm_year = -1900 + config_time_year(cfg);
+	time_start.tm_mon  = -1 + config_time_mon(cfg);
+	time_start.tm_mday = config_time_mday(cfg);
+	time_start.tm_hour = config_time_hour(cfg);
+	time_start.tm_min  = config_time_min(cfg);
+	time_start.tm_sec  = config_time_sec(cfg);
+	l->start_time = timegm(&time_start);
+
+	l->interval = config_interval(cfg);
+	l->num_data_conf = config_num_data_conf(cfg);
+	l->num_data_rec = config_num_data_rec(cfg);
+	l->fahrenheit = config_temp_is_fahrenheit(cfg) ? 1 : 0;
+	l->thresh_temp_low = config_thresh_temp_low(cfg);
+	l->thresh_temp_high = config_thresh_temp_high(cfg);
+	l->thresh_rh_low = config_thresh_rh_low(cfg);
+	l->thresh_rh_high = config_thresh_rh_high(cfg);
+}
+
+/* the config was read */
+void live_poll(struct config *cfg)
+{
+	struct vdl120shm_logger *l;
+
+	if (live == NULL)
+		return;
+	pthread_mutex_lock(&live_lock);
+	l = live_slot(cfg);
+	if (l != NULL)
+	{
+		live_begin(l);
+		live_config(l, cfg);
+		l->polls++;
+		l->last_poll = time(NULL);
+		live_end(l);
+	}
+	pthread_mutex_unlock(&live_lock);
+}
+
+/* new data points came in */
+void live_add(struct config *cfg, struct data *data_first)
+{
+	struct vdl120shm_logger *l;
+	struct data *data_curr;
+	struct vdl120shm_sample *s;
+
+	if (live == NULL || data_first == NULL)
+		return;
+	pthread_mutex_lock(&live_lock);
+	l = live_slot(cfg);
+	if (l != NULL)
+	{
+		live_begin(l);
+		live_config(l, cfg);
+		for (data_curr = data_first; data_curr != NULL; data_curr = data_curr->next)
+		{
+			/* older than the newest one: a download of old data */
+			if (l->num_samples > 0 && data_curr->time <= l->sample[(l->next + VDL120SHM_SAMPLES - 1) % VDL120SHM_SAMPLES].time)
+				continue;
+			s = &l->sample[l->next];
+			s->time = data_curr->time;
+			s->temp = data_curr->temp;
+			s->rh = data_curr->rh;
+			l->next = (l->next + 1) % VDL120SHM_SAMPLES;
+			if (l->num_samples < VDL120SHM_SAMPLES)
+				l->num_samples++;
+			l->data_points++;
+		}
+		l->last_data = time(NULL);
+		live_end(l);
+	}
+	pthread_mutex_unlock(&live_lock);
+}
+
+/* reading config or data failed, cfg is the config read before */
+void live_fail(struct config *cfg)
+{
+	struct vdl120shm_logger *l;
+
+	if (live == NULL)
+		return;
+	pthread_mutex_lock(&live_lock);
+	l = live_slot(cfg);
+	if (l != NULL)
+	{
+		live_begin(l);
+		l->failures++;
+		l->last_failure = time(NULL);
+		live_end(l);
+	}
+	pthread_mutex_unlock(&live_lock);
+}
+
+/* -l: print the table as a reader sees it */
+int live_print(char *name)
+{
+	struct vdl120shm *table;
+	struct vdl120shm_logger l;
+	struct vdl120shm_sample *s;
+	char time_str[32];
+	struct tm tm;
+	time_t stamp, now = time(NULL);
+	unsigned int i;
+
+	table = vdl120shm_map(name);
+	if (table == NULL)
+	{
+		printf("live_print: no table of version %i in %s\n", VDL120SHM_VERSION, name);
+		return 1;
+	}
+	printf("# written by pid %u since %lli sec\n", table->pid, (long long)(now - table->started));
+	printf("# logger location time temp rh polls failures data_points last_poll_age\n");
+	for (i = 0; i < table->num_loggers; i++)
+	{
+		vdl120shm_read(table, i, &l);
+		if (!l.used)
+			continue;
+		printf("%.16s %s ", l.name, l.location[0] ? l.location : "-");
+		s = vdl120shm_sample(&l, 0);
+		if (s == NULL)
+			printf("- - - ");
+		else
+		{
+			stamp = s->time;
+			gmtime_r(&stamp, &tm);
+			strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%S", &tm);
+			printf("%s %.1f %.1f ", time_str, s->temp / 10.0, s->rh / 10.0);
+		}
+		printf("%llu %llu %llu %lli\n",
+			(unsigned long long)l.polls, (unsigned long long)l.failures,
+			(unsigned long long)l.data_points, l.last_poll ? (long long)(now - l.last_poll) : -1LL);
+	}
+	vdl120shm_unmap(table);
+	return 0;
+}
@@ -9,8 +9,8 @@ short int bin2num(short int);
 #define NUM2BIN_MAX 100
 #define SIGN_BIT 0x8000 /* 1 << 15 */
 
-/* force byte order (endianness) by casting char -> short int */
-#define num2bin_data ((short int *)num2bin_data_char)
+/* little endian bytes, assembled so it works with any byte order */
+#define num2bin_data(i) ((short int)((num2bin_data_char[2*(i)] & 0xFF) | (num2bin_data_char[2*(i)+1] & 0xFF) << 8))
 char num2bin_data_char[] = 
 {
 	0x00, 0x00, /*   0 */
@@ -126,10 +126,10 @@ short int num2bin(short int num)
 	
 	if (num < 0)
 	{
-		return num2bin_data[-num] | SIGN_BIT; // set sign bit
+		return num2bin_data(-num) | SIGN_BIT; // set sign bit
 	}
 	
-	return num2bin_data[num];
+	return num2bin_data(num);
 }
 
 short int bin2num(short int bin)
@@ -157,7 +157,7 @@ short int bin2num(short int bin)
 	
 	for (i = 0; i <= NUM2BIN_MAX; i++)
 	{
-		if (num2bin_data[i] == bin)
+		if (num2bin_data(i) == bin)
 		{
 			if (is_negative)
 				return -i;
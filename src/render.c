@@ -0,0 +1,688 @@
+/* render temperature and humidity charts as SVG or PNG */
+
+/*
+*  the data is aggregated per pixel column of the plot area (number of
+*  data points, min, max and sum of temp and rh), so drawing costs the
+*  same for 100 or 100 million data points. the layout follows
+*  doc/messung.plt: time x axis, temp and rh in one y axis, grid.
+*
+*  PNG files are written without zlib: the palette image is compressed
+*  with fixed huffman codes and run-length matches, which is enough for
+*  mostly white charts.
+*/
+
+#define CHART_WIDTH 800   /* default image size, like in doc/messung.plt */
+#define CHART_HEIGHT 600
+#define CHART_LEFT 48     /* margins around the plot area, in pixels */
+#define CHART_RIGHT 16
+#define CHART_TOP 40
+#define CHART_BOTTOM 40
+
+/* palette */
+#define CHART_WHITE 0
+#define CHART_BLACK 1
+#define CHART_GRID 2
+#define CHART_TEMP 3
+#define CHART_TEMP_RANGE 4
+#define CHART_RH 5
+#define CHART_RH_RANGE 6
+
+unsigned char chart_palette[][3] = {
+	{ 0xFF, 0xFF, 0xFF },
+	{ 0x00, 0x00, 0x00 },
+	{ 0xA0, 0xA0, 0xA0 },
+	{ 0xFF, 0x00, 0x00 },
+	{ 0xFF, 0xB0, 0xB0 },
+	{ 0x00, 0xC0, 0x00 },
+	{ 0xA0, 0xF0, 0xA0 },
+};
+char *chart_colors[] = {
+	"#ffffff", "#000000", "#a0a0a0", "#ff0000", "#ffb0b0", "#00c000", "#a0f0a0"
+};
+
+struct chart_col {
+	int num;
+	short temp_min, temp_max;
+	short rh_min, rh_max;
+	long long temp_sum, rh_sum;
+};
+
+struct chart {
+	int width, height;
+	long long time_min, time_max;
+	int num_cols;                /* width of the plot area */
+	struct chart_col *cols;
+	int value_min, value_max;    /* y axis, in 1/10 units */
+	int value_step;
+	int time_step;               /* x axis tics, in seconds */
+	unsigned char *pixels;       /* palette indices, PNG only */
+};
+
+void chart_init(struct chart *ch, int width, int height, long long time_min, long long time_max);
+void chart_add(struct chart *ch, long long time, int temp, int rh);
+int chart_svg(struct chart *ch, char *path, char *title);
+int chart_png(struct chart *ch, char *path, char *title);
+int chart_write(struct chart *ch, char *path, char *title);
+void chart_free(struct chart *ch);
+
+
+/* 5x8 font for ASCII 32..126, one byte per column, bit 0 at the top, */
+/* glyph 127 is the degree sign */
+unsigned char chart_font[96][5] = {
+	{0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7F,0x14,0x7F,0x14},
+	{0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62}, {0x36,0x49,0x56,0x20,0x50}, {0x00,0x08,0x07,0x03,0x00},
+	{0x00,0x1C,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1C,0x00}, {0x2A,0x1C,0x7F,0x1C,0x2A}, {0x08,0x08,0x3E,0x08,0x08},
+	{0x00,0x80,0x70,0x30,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x00,0x60,0x60,0x00}, {0x20,0x10,0x08,0x04,0x02},
+	{0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00}, {0x72,0x49,0x49,0x49,0x46}, {0x21,0x41,0x49,0x4D,0x33},
+	{0x18,0x14,0x12,0x7F,0x10}, {0x27,0x45,0x45,0x45,0x39}, {0x3C,0x4A,0x49,0x49,0x31}, {0x41,0x21,0x11,0x09,0x07},
+	{0x36,0x49,0x49,0x49,0x36}, {0x46,0x49,0x49,0x29,0x1E}, {0x00,0x00,0x14,0x00,0x00}, {0x00,0x40,0x34,0x00,0x00},
+	{0x00,0x08,0x14,0x22,0x41}, {0x14,0x14,0x14,0x14,0x14}, {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x59,0x09,0x06},
+	{0x3E,0x41,0x5D,0x59,0x4E}, {0x7C,0x12,0x11,0x12,0x7C}, {0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22},
+	{0x7F,0x41,0x41,0x41,0x3E}, {0x7F,0x49,0x49,0x49,0x41}, {0x7F,0x09,0x09,0x09,0x01}, {0x3E,0x41,0x41,0x51,0x73},
+	{0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00}, {0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41},
+	{0x7F,0x40,0x40,0x40,0x40}, {0x7F,0x02,0x1C,0x02,0x7F}, {0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E},
+	{0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E}, {0x7F,0x09,0x19,0x29,0x46}, {0x26,0x49,0x49,0x49,0x32},
+	{0x03,0x01,0x7F,0x01,0x03}, {0x3F,0x40,0x40,0x40,0x3F}, {0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F},
+	{0x63,0x14,0x08,0x14,0x63}, {0x03,0x04,0x78,0x04,0x03}, {0x61,0x59,0x49,0x4D,0x43}, {0x00,0x7F,0x41,0x41,0x41},
+	{0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x41,0x7F}, {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40},
+	{0x00,0x03,0x07,0x08,0x00}, {0x20,0x54,0x54,0x78,0x40}, {0x7F,0x28,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x28},
+	{0x38,0x44,0x44,0x28,0x7F}, {0x38,0x54,0x54,0x54,0x18}, {0x00,0x08,0x7E,0x09,0x02}, {0x18,0xA4,0xA4,0x9C,0x78},
+	{0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00}, {0x20,0x40,0x40,0x3D,0x00}, {0x7F,0x10,0x28,0x44,0x00},
+	{0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x78,0x04,0x78}, {0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38},
+	{0xFC,0x18,0x24,0x24,0x18}, {0x18,0x24,0x24,0x18,0xFC}, {0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x24},
+	{0x04,0x04,0x3F,0x44,0x24}, {0x3C,0x40,0x40,0x20,0x7C}, {0x1C,0x20,0x40,0x20,0x1C}, {0x3C,0x40,0x30,0x40,0x3C},
+	{0x44,0x28,0x10,0x28,0x44}, {0x4C,0x90,0x90,0x90,0x7C}, {0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00},
+	{0x00,0x00,0x77,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00}, {0x02,0x01,0x02,0x04,0x02}, {0x00,0x06,0x09,0x09,0x06},
+};
+
+
+void chart_init(struct chart *ch, int width, int height, long long time_min, long long time_max)
+{
+	memset(ch, 0, sizeof(*ch));
+	ch->width = width;
+	ch->height = height;
+	ch->time_min = time_min;
+	ch->time_max = time_max > time_min ? time_max : time_min + 1;
+	ch->num_cols = width - CHART_LEFT - CHART_RIGHT;
+	ch->cols = calloc(ch->num_cols, sizeof(struct chart_col));
+}
+
+void chart_add(struct chart *ch, long long time, int temp, int rh)
+{
+	struct chart_col *col;
+	int x;
+
+	if (time < ch->time_min || ch->time_max < time)
+		return;
+
+	x = (time - ch->time_min) * (ch->num_cols - 1) / (ch->time_max - ch->time_min);
+	col = &ch->cols[x];
+
+	if (col->num == 0 || temp < col->temp_min)
+		col->temp_min = temp;
+	if (col->num == 0 || temp > col->temp_max)
+		col->temp_max = temp;
+	if (col->num == 0 || rh < col->rh_min)
+		col->rh_min = rh;
+	if (col->num == 0 || rh > col->rh_max)
+		col->rh_max = rh;
+	col->temp_sum += temp;
+	col->rh_sum += rh;
+	col->num++;
+}
+
+void chart_free(struct chart *ch)
+{
+	free(ch->cols);
+	free(ch->pixels);
+	ch->cols = NULL;
+	ch->pixels = NULL;
+}
+
+/* pick axis ranges and tic steps from the aggregated data */
+void chart_scale(struct chart *ch)
+{
+	int steps[] = { 10, 20, 50, 100, 200, 500, 1000 };
+	int time_steps[] = { 60, 300, 900, 1800, 3600, 2*3600, 3*3600, 6*3600, 12*3600,
+		86400, 2*86400, 7*86400, 14*86400, 28*86400, 91*86400, 365*86400 };
+	int lo = 0, hi = 0, found = 0, i, max_tics;
+	struct chart_col *col;
+
+	for (i = 0; i < ch->num_cols; i++)
+	{
+		col = &ch->cols[i];
+		if (col->num == 0)
+			continue;
+		if (!found || col->temp_min < lo) lo = col->temp_min;
+		if (!found || col->rh_min < lo) lo = col->rh_min;
+		if (!found || col->temp_max > hi) hi = col->temp_max;
+		if (!found || col->rh_max > hi) hi = col->rh_max;
+		found = 1;
+	}
+
+	/* about 8 tics on the y axis, like gnuplot */
+	for (i = 0; i < 6 && (hi - lo) / steps[i] > 8; i++)
+		;
+	ch->value_step = steps[i];
+	ch->value_min = lo >= 0 ? lo / steps[i] * steps[i] : -((-lo + steps[i] - 1) / steps[i] * steps[i]);
+	ch->value_max = hi >= 0 ? (hi + steps[i] - 1) / steps[i] * steps[i] : -(-hi / steps[i] * steps[i]);
+	if (ch->value_max <= ch->value_min)
+		ch->value_max = ch->value_min + steps[i];
+
+	/* time labels are about 90 pixels wide */
+	max_tics = ch->num_cols / 90 > 1 ? ch->num_cols / 90 : 1;
+	for (i = 0; i < 15 && (ch->time_max - ch->time_min) / time_steps[i] > max_tics; i++)
+		;
+	ch->time_step = time_steps[i];
+}
+
+int chart_y(struct chart *ch, double value)
+{
+	int plot_h = ch->height - CHART_TOP - CHART_BOTTOM;
+
+	return CHART_TOP + plot_h - (int)((value - ch->value_min) * (plot_h - 1) / (ch->value_max - ch->value_min) + 0.5);
+}
+
+int chart_x(struct chart *ch, long long time)
+{
+	return CHART_LEFT + (time - ch->time_min) * (ch->num_cols - 1) / (ch->time_max - ch->time_min);
+}
+
+/* first tic at a multiple of the step */
+long long chart_first_tic(struct chart *ch)
+{
+	return (ch->time_min + ch->time_step - 1) / ch->time_step * ch->time_step;
+}
+
+void chart_time_label(long long time, char *date, char *clock)
+{
+	time_t stamp = time;
+	struct tm tm;
+
+	/* timestamps are local time in GMT, see read_data */
+	gmtime_r(&stamp, &tm);
+	strftime(date, 16, "%d.%m.%Y", &tm);
+	strftime(clock, 16, "%H:%M", &tm);
+}
+
+
+/* SVG */
+
+/* text as XML character data: markup escaped, control characters and */
+/* bytes that are no valid UTF-8 dropped */
+static void chart_svg_text(FILE *svg, char *text)
+{
+	unsigned char *p = (unsigned char *)text;
+	unsigned char lo, hi;
+	int n, i;
+
+	while (*p)
+	{
+		if (*p == '&') fputs("&amp;", svg);
+		else if (*p == '<') fputs("&lt;", svg);
+		else if (*p == '>') fputs("&gt;", svg);
+		else if (*p == '"') fputs("&quot;", svg);
+		else if (*p >= 0x20 && *p < 0x7F) fputc(*p, svg);
+		if (*p < 0xC2 || *p > 0xF4)
+		{
+			p++;
+			continue;
+		}
+
+		/* a multibyte sequence, the second byte's range excludes */
+		/* overlong forms, surrogates and code points above U+10FFFF */
+		n = *p < 0xE0 ? 2 : *p < 0xF0 ? 3 : 4;
+		lo = *p == 0xE0 ? 0xA0 : *p == 0xF0 ? 0x90 : 0x80;
+		hi = *p == 0xED ? 0x9F : *p == 0xF4 ? 0x8F : 0xBF;
+		for (i = 1; i < n && (p[i] & 0xC0) == 0x80; i++)
+			if (i == 1 && (p[i] < lo || p[i] > hi))
+				break;
+		if (i == n)
+			fwrite(p, 1, n, svg);
+		p += i == n ? n : 1;
+	}
+}
+
+int chart_svg(struct chart *ch, char *path, char *title)
+{
+	FILE *svg;
+	struct chart_col *col;
+	long long t;
+	int i, v, x, y, first;
+	char date[16], clock[16];
+	int plot_h = ch->height - CHART_TOP - CHART_BOTTOM;
+
+	svg = fopen(path, "w");
+	if (svg == NULL)
+	{
+		printf("chart_svg: failed to fopen(\"%s\", \"w\")\n", path);
+		return 1;
+	}
+	chart_scale(ch);
+
+	fprintf(svg, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	fprintf(svg, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%i\" height=\"%i\" "
+		"font-family=\"sans-serif\" font-size=\"10\">\n", ch->width, ch->height + 60);
+	fprintf(svg, "<rect width=\"100%%\" height=\"100%%\" fill=\"%s\"/>\n", chart_colors[CHART_WHITE]);
+	fprintf(svg, "<text x=\"%i\" y=\"16\" text-anchor=\"middle\" font-size=\"12\">", ch->width / 2);
+	chart_svg_text(svg, title);
+	fprintf(svg, "</text>\n");
+
+	/* grid and y tics */
+	fprintf(svg, "<g stroke=\"%s\" stroke-dasharray=\"1,3\">\n", chart_colors[CHART_GRID]);
+	for (v = ch->value_min; v <= ch->value_max; v += ch->value_step)
+		fprintf(svg, "<line x1=\"%i\" y1=\"%i\" x2=\"%i\" y2=\"%i\"/>\n",
+			CHART_LEFT, chart_y(ch, v), CHART_LEFT + ch->num_cols - 1, chart_y(ch, v));
+	for (t = chart_first_tic(ch); t <= ch->time_max; t += ch->time_step)
+		fprintf(svg, "<line x1=\"%i\" y1=\"%i\" x2=\"%i\" y2=\"%i\"/>\n",
+			chart_x(ch, t), CHART_TOP, chart_x(ch, t), CHART_TOP + plot_h);
+	fprintf(svg, "</g>\n");
+
+	fprintf(svg, "<g text-anchor=\"end\">\n");
+	for (v = ch->value_min; v <= ch->value_max; v += ch->value_step)
+		fprintf(svg, "<text x=\"%i\" y=\"%i\">%g</text>\n", CHART_LEFT - 4, chart_y(ch, v) + 3, v / 10.0);
+	fprintf(svg, "</g>\n");
+
+	/* x tics, rotated like in messung.plt */
+	for (t = chart_first_tic(ch); t <= ch->time_max; t += ch->time_step)
+	{
+		chart_time_label(t, date, clock);
+		x = chart_x(ch, t);
+		y = CHART_TOP + plot_h + 10;
+		fprintf(svg, "<text x=\"%i\" y=\"%i\" transform=\"rotate(60 %i %i)\">%s %s</text>\n",
+			x, y, x, y, date, clock);
+	}
+
+	/* min/max range per pixel column, then the mean as a line */
+	for (i = 0; i < 2; i++)
+	{
+		fprintf(svg, "<path stroke=\"%s\" fill=\"none\" d=\"", chart_colors[i ? CHART_RH_RANGE : CHART_TEMP_RANGE]);
+		for (x = 0; x < ch->num_cols; x++)
+		{
+			col = &ch->cols[x];
+			if (col->num == 0)
+				continue;
+			fprintf(svg, "M%i.5 %iV%i",
+				CHART_LEFT + x,
+				chart_y(ch, i ? col->rh_max : col->temp_max),
+				chart_y(ch, i ? col->rh_min : col->temp_min) + 1);
+		}
+		fprintf(svg, "\"/>\n");
+
+		fprintf(svg, "<path stroke=\"%s\" fill=\"none\" d=\"", chart_colors[i ? CHART_RH : CHART_TEMP]);
+		first = 1;
+		for (x = 0; x < ch->num_cols; x++)
+		{
+			col = &ch->cols[x];
+			if (col->num == 0)
+				continue;
+			fprintf(svg, "%c%i.5 %i", first ? 'M' : 'L', CHART_LEFT + x,
+				chart_y(ch, (double)(i ? col->rh_sum : col->temp_sum) / col->num));
+			first = 0;
+		}
+		fprintf(svg, "\"/>\n");
+	}
+
+	/* border and legend */
+	fprintf(svg, "<rect x=\"%i.5\" y=\"%i.5\" width=\"%i\" height=\"%i\" fill=\"none\" stroke=\"%s\"/>\n",
+		CHART_LEFT - 1, CHART_TOP - 1, ch->num_cols + 1, plot_h + 1, chart_colors[CHART_BLACK]);
+	fprintf(svg, "<g text-anchor=\"end\">\n");
+	fprintf(svg, "<text x=\"%i\" y=\"%i\">Temp / °C</text>\n", ch->width - CHART_RIGHT - 30, CHART_TOP - 18);
+	fprintf(svg, "<line x1=\"%i\" y1=\"%i\" x2=\"%i\" y2=\"%i\" stroke=\"%s\"/>\n",
+		ch->width - CHART_RIGHT - 26, CHART_TOP - 21, ch->width - CHART_RIGHT, CHART_TOP - 21, chart_colors[CHART_TEMP]);
+	fprintf(svg, "<text x=\"%i\" y=\"%i\">RLF / %%</text>\n", ch->width - CHART_RIGHT - 30, CHART_TOP - 6);
+	fprintf(svg, "<line x1=\"%i\" y1=\"%i\" x2=\"%i\" y2=\"%i\" stroke=\"%s\"/>\n",
+		ch->width - CHART_RIGHT - 26, CHART_TOP - 9, ch->width - CHART_RIGHT, CHART_TOP - 9, chart_colors[CHART_RH]);
+	fprintf(svg, "</g>\n");
+	fprintf(svg, "</svg>\n");
+
+	if (0 != fclose(svg))
+	{
+		printf("chart_svg: failed to write %s\n", path);
+		return 1;
+	}
+	return 0;
+}
+
+
+/* PNG: drawing */
+
+void chart_pixel(struct chart *ch, int x, int y, int color)
+{
+	if (0 <= x && x < ch->width && 0 <= y && y < ch->height)
+		ch->pixels[y * ch->width + x] = color;
+}
+
+void chart_vline(struct chart *ch, int x, int y1, int y2, int color, int dotted)
+{
+	int y;
+
+	if (y2 < y1) { y = y1; y1 = y2; y2 = y; }
+	for (y = y1; y <= y2; y++)
+		if (!dotted || y % 3 == 0)
+			chart_pixel(ch, x, y, color);
+}
+
+void chart_hline(struct chart *ch, int x1, int x2, int y, int color, int dotted)
+{
+	int x;
+
+	for (x = x1; x <= x2; x++)
+		if (!dotted || x % 3 == 0)
+			chart_pixel(ch, x, y, color);
+}
+
+/* draw UTF-8 text, align: 0 = left, 1 = center, 2 = right */
+void chart_text(struct chart *ch, int x, int y, char *text, int align)
+{
+	unsigned char *c;
+	int len = 0, col, row, glyph;
+
+	for (c = (unsigned char *)text; *c; c++)
+		if (*c < 0x80 || *c == 0xC2)
+			len++;
+	x -= align * len * 6 / 2;
+
+	for (c = (unsigned char *)text; *c; c++)
+	{
+		if (*c == 0xC2)
+			continue;
+		glyph = *c == 0xB0 ? 127 : (*c < 32 || *c > 126) ? '?' : *c;
+		for (col = 0; col < 5; col++)
+			for (row = 0; row < 8; row++)
+				if (chart_font[glyph - 32][col] & (1 << row))
+					chart_pixel(ch, x + col, y + row, CHART_BLACK);
+		x += 6;
+	}
+}
+
+
+/* PNG: encoding */
+
+unsigned int crc32_table[256];
+
+unsigned int crc32_update(unsigned int crc, unsigned char *bytes, int size)
+{
+	unsigned int c;
+	int i, k;
+
+	if (crc32_table[1] == 0)
+	{
+		for (i = 0; i < 256; i++)
+		{
+			c = i;
+			for (k = 0; k < 8; k++)
+				c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			crc32_table[i] = c;
+		}
+	}
+
+	crc ^= 0xFFFFFFFF;
+	for (i = 0; i < size; i++)
+		crc = crc32_table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+	return crc ^ 0xFFFFFFFF;
+}
+
+struct bits {
+	unsigned char *buf;
+	int len;
+	unsigned int acc;
+	int num;
+};
+
+void bits_put(struct bits *b, unsigned int value, int num)
+{
+	b->acc |= value << b->num;
+	b->num += num;
+	while (b->num >= 8)
+	{
+		b->buf[b->len++] = b->acc & 0xFF;
+		b->acc >>= 8;
+		b->num -= 8;
+	}
+}
+
+/* huffman codes go out most significant bit first */
+void bits_huff(struct bits *b, unsigned int code, int num)
+{
+	unsigned int rev = 0;
+	int i;
+
+	for (i = 0; i < num; i++)
+		rev |= ((code >> i) & 1) << (num - 1 - i);
+	bits_put(b, rev, num);
+}
+
+void deflate_literal(struct bits *b, int lit)
+{
+	if (lit < 144)
+		bits_huff(b, 0x30 + lit, 8);
+	else if (lit < 256)
+		bits_huff(b, 0x190 + lit - 144, 9);
+	else if (lit < 280)
+		bits_huff(b, lit - 256, 7);
+	else
+		bits_huff(b, 0xC0 + lit - 280, 8);
+}
+
+void deflate_match(struct bits *b, int len, int dist)
+{
+	int len_base[] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+	int len_extra[] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+	int dist_base[] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,
+		2049,3073,4097,6145,8193,12289,16385,24577 };
+	int dist_extra[] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+	int i;
+
+	for (i = 28; len_base[i] > len; i--)
+		;
+	deflate_literal(b, 257 + i);
+	bits_put(b, len - len_base[i], len_extra[i]);
+
+	for (i = 29; dist_base[i] > dist; i--)
+		;
+	bits_huff(b, i, 5);
+	bits_put(b, dist - dist_base[i], dist_extra[i]);
+}
+
+/* zlib stream of one fixed huffman block, matches against the previous */
+/* byte or the previous row only. return value: compressed size */
+int deflate_rows(unsigned char *in, int size, int stride, unsigned char *out)
+{
+	struct bits b = { out, 0, 0, 0 };
+	unsigned int s1 = 1, s2 = 0;
+	int pos, len, best, dist, i;
+
+	bits_put(&b, 0x78, 8);
+	bits_put(&b, 0x01, 8);
+	bits_put(&b, 1, 1); /* final block */
+	bits_put(&b, 1, 2); /* fixed huffman codes */
+
+	for (pos = 0; pos < size; )
+	{
+		best = 0;
+		dist = 0;
+		if (pos >= stride)
+		{
+			for (len = 0; len < 258 && pos + len < size && in[pos + len] == in[pos + len - stride]; len++)
+				;
+			best = len;
+			dist = stride;
+		}
+		if (pos >= 1)
+		{
+			for (len = 0; len < 258 && pos + len < size && in[pos + len] == in[pos - 1]; len++)
+				;
+			if (len > best)
+			{
+				best = len;
+				dist = 1;
+			}
+		}
+
+		if (best >= 3)
+		{
+			deflate_match(&b, best, dist);
+			pos += best;
+		}
+		else
+		{
+			deflate_literal(&b, in[pos]);
+			pos++;
+		}
+	}
+	deflate_literal(&b, 256);
+	if (b.num > 0)
+		bits_put(&b, 0, 8 - b.num);
+
+	for (i = 0; i < size; i++)
+	{
+		s1 = (s1 + in[i]) % 65521;
+		s2 = (s2 + s1) % 65521;
+	}
+	bits_put(&b, s2 >> 8, 8);
+	bits_put(&b, s2 & 0xFF, 8);
+	bits_put(&b, s1 >> 8, 8);
+	bits_put(&b, s1 & 0xFF, 8);
+
+	return b.len;
+}
+
+void png_chunk(FILE *png, char *type, unsigned char *data, int size)
+{
+	unsigned char head[8];
+	unsigned int crc;
+	int i;
+
+	for (i = 0; i < 4; i++)
+		head[i] = (size >> (24 - 8*i)) & 0xFF;
+	memcpy(head + 4, type, 4);
+	crc = crc32_update(0, head + 4, 4);
+	crc = crc32_update(crc, data, size);
+
+	fwrite(head, 1, 8, png);
+	fwrite(data, 1, size, png);
+	for (i = 0; i < 4; i++)
+		head[i] = (crc >> (24 - 8*i)) & 0xFF;
+	fwrite(head, 1, 4, png);
+}
+
+int chart_png(struct chart *ch, char *path, char *title)
+{
+	FILE *png;
+	struct chart_col *col;
+	unsigned char ihdr[13], *rows, *zdata;
+	long long t;
+	int i, v, x, y, y_prev = -1, stride, size;
+	char label[32], date[16], clock[16];
+	int plot_h = ch->height - CHART_TOP - CHART_BOTTOM;
+
+	png = fopen(path, "wb");
+	if (png == NULL)
+	{
+		printf("chart_png: failed to fopen(\"%s\", \"wb\")\n", path);
+		return 1;
+	}
+	chart_scale(ch);
+	ch->pixels = calloc(ch->width * ch->height, 1);
+
+	chart_text(ch, ch->width / 2, 8, title, 1);
+
+	/* grid and tics */
+	for (v = ch->value_min; v <= ch->value_max; v += ch->value_step)
+	{
+		chart_hline(ch, CHART_LEFT, CHART_LEFT + ch->num_cols - 1, chart_y(ch, v), CHART_GRID, 1);
+		sprintf(label, "%g", v / 10.0);
+		chart_text(ch, CHART_LEFT - 5, chart_y(ch, v) - 3, label, 2);
+	}
+	for (t = chart_first_tic(ch); t <= ch->time_max; t += ch->time_step)
+	{
+		x = chart_x(ch, t);
+		chart_vline(ch, x, CHART_TOP, CHART_TOP + plot_h - 1, CHART_GRID, 1);
+		chart_time_label(t, date, clock);
+		chart_text(ch, x, CHART_TOP + plot_h + 6, date, 1);
+		chart_text(ch, x, CHART_TOP + plot_h + 16, clock, 1);
+	}
+
+	/* min/max ranges first, means on top */
+	for (x = 0; x < ch->num_cols; x++)
+	{
+		col = &ch->cols[x];
+		if (col->num == 0)
+			continue;
+		chart_vline(ch, CHART_LEFT + x, chart_y(ch, col->temp_min), chart_y(ch, col->temp_max), CHART_TEMP_RANGE, 0);
+		chart_vline(ch, CHART_LEFT + x, chart_y(ch, col->rh_min), chart_y(ch, col->rh_max), CHART_RH_RANGE, 0);
+	}
+	for (i = 0; i < 2; i++)
+	{
+		y_prev = -1;
+		for (x = 0; x < ch->num_cols; x++)
+		{
+			col = &ch->cols[x];
+			if (col->num == 0)
+				continue;
+			y = chart_y(ch, (double)(i ? col->rh_sum : col->temp_sum) / col->num);
+			chart_vline(ch, CHART_LEFT + x, y, y_prev < 0 ? y : y_prev, i ? CHART_RH : CHART_TEMP, 0);
+			y_prev = y;
+		}
+	}
+
+	/* border and legend */
+	chart_hline(ch, CHART_LEFT - 1, CHART_LEFT + ch->num_cols, CHART_TOP - 1, CHART_BLACK, 0);
+	chart_hline(ch, CHART_LEFT - 1, CHART_LEFT + ch->num_cols, CHART_TOP + plot_h, CHART_BLACK, 0);
+	chart_vline(ch, CHART_LEFT - 1, CHART_TOP - 1, CHART_TOP + plot_h, CHART_BLACK, 0);
+	chart_vline(ch, CHART_LEFT + ch->num_cols, CHART_TOP - 1, CHART_TOP + plot_h, CHART_BLACK, 0);
+	chart_text(ch, ch->width - CHART_RIGHT - 30, CHART_TOP - 26, "Temp / °C", 2);
+	chart_hline(ch, ch->width - CHART_RIGHT - 24, ch->width - CHART_RIGHT, CHART_TOP - 23, CHART_TEMP, 0);
+	chart_text(ch, ch->width - CHART_RIGHT - 30, CHART_TOP - 14, "RLF / %", 2);
+	chart_hline(ch, ch->width - CHART_RIGHT - 24, ch->width - CHART_RIGHT, CHART_TOP - 11, CHART_RH, 0);
+
+	/* one filter byte (none) in front of each row */
+	stride = ch->width + 1;
+	rows = malloc(stride * ch->height);
+	for (y = 0; y < ch->height; y++)
+	{
+		rows[y * stride] = 0;
+		memcpy(rows + y * stride + 1, ch->pixels + y * ch->width, ch->width);
+	}
+	/* worst case: 9 bits per literal */
+	zdata = malloc(stride * ch->height * 9 / 8 + 64);
+	size = deflate_rows(rows, stride * ch->height, stride, zdata);
+
+	for (i = 0; i < 4; i++)
+	{
+		ihdr[i] = (ch->width >> (24 - 8*i)) & 0xFF;
+		ihdr[4+i] = (ch->height >> (24 - 8*i)) & 0xFF;
+	}
+	ihdr[8] = 8;  /* bit depth */
+	ihdr[9] = 3;  /* palette */
+	ihdr[10] = 0; /* deflate */
+	ihdr[11] = 0; /* adaptive filtering */
+	ihdr[12] = 0; /* no interlace */
+
+	fwrite("\x89PNG\r\n\x1a\n", 1, 8, png);
+	png_chunk(png, "IHDR", ihdr, 13);
+	png_chunk(png, "PLTE", (unsigned char *)chart_palette, sizeof(chart_palette));
+	png_chunk(png, "IDAT", zdata, size);
+	png_chunk(png, "IEND", NULL, 0);
+
+	free(rows);
+	free(zdata);
+
+	if (0 != fclose(png))
+	{
+		printf("chart_png: failed to write %s\n", path);
+		return 1;
+	}
+	return 0;
+}
+
+/* PNG or SVG, depending on the file name */
+int chart_write(struct chart *ch, char *path, char *title)
+{
+	char *ext = strrchr(path, '.');
+
+	if (ext != NULL && 0 == strcasecmp(ext, ".png"))
+		return chart_png(ch, path, title);
+	return chart_svg(ch, path, title);
+}
@@ -0,0 +1,112 @@
+/* bounded single producer / single consumer ring of pointers, lock-free */
+
+/*
+*  one thread pushes, one other thread pops. head is only written by the
+*  producer, tail only by the consumer, so plain loads and stores with
+*  acquire/release order are enough: no locks, no compare-and-swap. the
+*  release store of head publishes the slot written before it, the
+*  release store of tail hands the slot back.
+*
+*  head and tail count up forever, the slot is the count modulo the size,
+*  a power of two. they sit on separate cache lines so producer and
+*  consumer do not steal the line from each other on every operation.
+*
+*  ring_push_wait and ring_pop_wait spin briefly, then yield, then sleep
+*  in short steps: the stages of a download wait for usb, which takes
+*  milliseconds, so there is no point in burning a cpu.
+*/
+
+#define RING_CACHE_LINE 64
+
+struct ring {
+	void **slot;
+	unsigned int mask;              /* size - 1 */
+	_Alignas(RING_CACHE_LINE) atomic_uint head; /* next slot to push, producer */
+	_Alignas(RING_CACHE_LINE) atomic_uint tail; /* next slot to pop, consumer */
+};
+
+int ring_init(struct ring *r, unsigned int size);
+int ring_push(struct ring *r, void *item);
+void *ring_pop(struct ring *r);
+void ring_push_wait(struct ring *r, void *item);
+void *ring_pop_wait(struct ring *r);
+void ring_free(struct ring *r);
+
+
+/* size is rounded up to a power of two */
+int ring_init(struct ring *r, unsigned int size)
+{
+	unsigned int n = 1;
+
+	while (n < size)
+		n <<= 1;
+	r->slot = calloc(n, sizeof(void *));
+	if (r->slot == NULL)
+		return 1;
+	r->mask = n - 1;
+	atomic_init(&r->head, 0);
+	atomic_init(&r->tail, 0);
+	return 0;
+}
+
+/* return value: 0 = pushed, 1 = full */
+int ring_push(struct ring *r, void *item)
+{
+	unsigned int head = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+	if (head - atomic_load_explicit(&r->tail, memory_order_acquire) > r->mask)
+		return 1;
+	r->slot[head & r->mask] = item;
+	atomic_store_explicit(&r->head, head + 1, memory_order_release);
+	return 0;
+}
+
+/* return value: item, NULL = empty */
+void *ring_pop(struct ring *r)
+{
+	unsigned int tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+	void *item;
+
+	if (tail == atomic_load_explicit(&r->head, memory_order_acquire))
+		return NULL;
+	item = r->slot[tail & r->mask];
+	atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+	return item;
+}
+
+static void ring_backoff(int *round)
+{
+	struct timespec pause = { 0, 50000 };
+
+	if (*round < 100)
+		;
+	else if (*round < 110)
+		sched_yield();
+	else
+		nanosleep(&pause, NULL);
+	(*round)++;
+}
+
+void ring_push_wait(struct ring *r, void *item)
+{
+	int round = 0;
+
+	while (0 != ring_push(r, item))
+		ring_backoff(&round);
+}
+
+void *ring_pop_wait(struct ring *r)
+{
+	void *item;
+	int round = 0;
+
+	while ((item = ring_pop(r)) == NULL)
+		ring_backoff(&round);
+	return item;
+}
+
+void ring_free(struct ring *r)
+{
+	free(r->slot);
+	r->slot = NULL;
+}
@@ -0,0 +1,228 @@
+/* rollup tiers: hourly and daily aggregates of old stored data */
+
+/*
+*  -o rolls the sessions of LOGNAME.dat that are older than a given age
+*  into LOGNAME.hourly and LOGNAME.daily and optionally drops them from
+*  LOGNAME.dat. a tier file is text, one bucket per line:
+*
+*   # vdl120 rollup WIDTH sec, rolled up to TIME
+*   START COUNT TEMP_MIN TEMP_MAX TEMP_MEAN TEMP_SUMSQ RH_MIN RH_MAX RH_MEAN RH_SUMSQ
+*
+*  START is the bucket's first second, TIME the newest data point rolled
+*  up so far, both as in LOGNAME.dat. SUMSQ is the sum of the squared
+*  values, so buckets merge exactly and give the standard deviation.
+*  internally the values are tenths, summed as integers.
+*
+*  -b reads the coarsest tier whose width divides the query step for the
+*  rolled up time, and LOGNAME.dat only for the rest. a step no tier
+*  divides is read from LOGNAME.dat alone and fails if -o dropped the
+*  rolled up time from there.
+*/
+
+#define ROLLUP_HOUR 3600
+#define ROLLUP_DAY 86400
+
+struct rollup_bucket {
+	long long start;
+	long long count;
+	int temp_min, temp_max;         /* tenths */
+	long long temp_sum, temp_sumsq; /* tenths, tenths^2 */
+	int rh_min, rh_max;
+	long long rh_sum, rh_sumsq;
+};
+
+struct rollup_tier {
+	int width;                      /* seconds */
+	long long rolled;               /* newest time rolled up, -1 = none */
+	struct rollup_bucket *bucket;   /* sorted by start */
+	int num, cap;
+};
+
+int rollup_load(struct rollup_tier *tier, char *path, int width);
+void rollup_add(struct rollup_tier *tier, long long time, int temp, int rh);
+int rollup_save(struct rollup_tier *tier, char *path);
+int rollup_header(FILE *file, int *width, long long *rolled);
+int rollup_next(FILE *file, struct rollup_bucket *b);
+void rollup_merge(struct rollup_bucket *into, struct rollup_bucket *b);
+void rollup_free(struct rollup_tier *tier);
+
+
+static long long rollup_floor(long long time, int width)
+{
+	return (time >= 0 ? time / width : (time - width + 1) / width) * width;
+}
+
+/* tenths --> mean as printed, and back, exact below 100000 values */
+static long long rollup_sum(double mean, long long count)
+{
+	double sum = mean * count * 10;
+	return sum < 0 ? sum - 0.5 : sum + 0.5;
+}
+
+int rollup_header(FILE *file, int *width, long long *rolled)
+{
+	char line[256];
+
+	if (fgets(line, sizeof(line), file) == NULL ||
+		2 != sscanf(line, "# vdl120 rollup %d sec, rolled up to %lld", width, rolled) || *width <= 0)
+		return 1;
+	return 0;
+}
+
+/* return value: 0 = bucket read, 1 = end of file */
+int rollup_next(FILE *file, struct rollup_bucket *b)
+{
+	char line[512];
+	double temp_min, temp_max, temp_mean, temp_sumsq, rh_min, rh_max, rh_mean, rh_sumsq;
+
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		if (10 != sscanf(line, "%lld %lld %lf %lf %lf %lf %lf %lf %lf %lf",
+			&b->start, &b->count, &temp_min, &temp_max, &temp_mean, &temp_sumsq,
+			&rh_min, &rh_max, &rh_mean, &rh_sumsq) || b->count <= 0)
+			continue;
+		b->temp_min = temp_min < 0 ? temp_min * 10 - 0.5 : temp_min * 10 + 0.5;
+		b->temp_max = temp_max < 0 ? temp_max * 10 - 0.5 : temp_max * 10 + 0.5;
+		b->temp_sum = rollup_sum(temp_mean, b->count);
+		b->temp_sumsq = temp_sumsq * 100 + 0.5;
+		b->rh_min = rh_min * 10 + 0.5;
+		b->rh_max = rh_max * 10 + 0.5;
+		b->rh_sum = rollup_sum(rh_mean, b->count);
+		b->rh_sumsq = rh_sumsq * 100 + 0.5;
+		return 0;
+	}
+	return 1;
+}
+
+void rollup_merge(struct rollup_bucket *into, struct rollup_bucket *b)
+{
+	if (into->count == 0)
+	{
+		long long start = into->start;
+		*into = *b;
+		into->start = start;
+		return;
+	}
+	if (b->count == 0)
+		return;
+	into->count += b->count;
+	if (b->temp_min < into->temp_min) into->temp_min = b->temp_min;
+	if (b->temp_max > into->temp_max) into->temp_max = b->temp_max;
+	into->temp_sum += b->temp_sum;
+	into->temp_sumsq += b->temp_sumsq;
+	if (b->rh_min < into->rh_min) into->rh_min = b->rh_min;
+	if (b->rh_max > into->rh_max) into->rh_max = b->rh_max;
+	into->rh_sum += b->rh_sum;
+	into->rh_sumsq += b->rh_sumsq;
+}
+
+/* a missing file is an empty tier */
+int rollup_load(struct rollup_tier *tier, char *path, int width)
+{
+	struct rollup_bucket b;
+	FILE *file;
+
+	memset(tier, 0, sizeof(*tier));
+	tier->width = width;
+	tier->rolled = -1;
+
+	file = fopen(path, "r");
+	if (file == NULL)
+		return 0;
+	if (0 != rollup_header(file, &tier->width, &tier->rolled) || tier->width != width)
+	{
+		printf("rollup_load: %s is not a rollup of %i sec\n", path, width);
+		fclose(file);
+		return 1;
+	}
+	while (0 == rollup_next(file, &b))
+	{
+		if (tier->num == tier->cap)
+		{
+			tier->cap = tier->cap ? tier->cap * 2 : 1024;
+			tier->bucket = realloc(tier->bucket, tier->cap * sizeof(struct rollup_bucket));
+		}
+		tier->bucket[tier->num++] = b;
+	}
+	fclose(file);
+	return 0;
+}
+
+void rollup_add(struct rollup_tier *tier, long long time, int temp, int rh)
+{
+	struct rollup_bucket b;
+	long long start = rollup_floor(time, tier->width);
+	int i;
+
+	/* the archive is in time order, so this is almost always the last bucket */
+	for (i = tier->num; i > 0 && tier->bucket[i-1].start > start; i--)
+		;
+	if (i == 0 || tier->bucket[i-1].start != start)
+	{
+		if (tier->num == tier->cap)
+		{
+			tier->cap = tier->cap ? tier->cap * 2 : 1024;
+			tier->bucket = realloc(tier->bucket, tier->cap * sizeof(struct rollup_bucket));
+		}
+		memmove(tier->bucket + i + 1, tier->bucket + i, (tier->num - i) * sizeof(struct rollup_bucket));
+		memset(tier->bucket + i, 0, sizeof(struct rollup_bucket));
+		tier->bucket[i].start = start;
+		tier->num++;
+		i++;
+	}
+
+	b.start = start;
+	b.count = 1;
+	b.temp_min = b.temp_max = temp;
+	b.temp_sum = temp;
+	b.temp_sumsq = (long long)temp * temp;
+	b.rh_min = b.rh_max = rh;
+	b.rh_sum = rh;
+	b.rh_sumsq = (long long)rh * rh;
+	rollup_merge(&tier->bucket[i-1], &b);
+
+	if (time > tier->rolled)
+		tier->rolled = time;
+}
+
+int rollup_save(struct rollup_tier *tier, char *path)
+{
+	struct rollup_bucket *b;
+	char tmp_path[1100];
+	FILE *file;
+	int i, fd, synced;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	file = fopen(tmp_path, "w");
+	if (file == NULL)
+	{
+		printf("rollup_save: failed to fopen(\"%s\", \"w\")\n", tmp_path);
+		return 1;
+	}
+	fprintf(file, "# vdl120 rollup %i sec, rolled up to %lld\n", tier->width, tier->rolled);
+	for (i = 0; i < tier->num; i++)
+	{
+		b = &tier->bucket[i];
+		fprintf(file, "%lld %lld %.1f %.1f %.6f %.2f %.1f %.1f %.6f %.2f\n",
+			b->start, b->count,
+			b->temp_min / 10.0, b->temp_max / 10.0, (double)b->temp_sum / b->count / 10, b->temp_sumsq / 100.0,
+			b->rh_min / 10.0, b->rh_max / 10.0, (double)b->rh_sum / b->count / 10, b->rh_sumsq / 100.0);
+	}
+	/* on disk before it replaces the tier, see compact_archive */
+	fd = fileno(file);
+	synced = 0 == fflush(file) && 0 == archive_commit(&fd, 1);
+	if (0 != fclose(file) || !synced || 0 != rename(tmp_path, path))
+	{
+		printf("rollup_save: failed to write %s\n", path);
+		unlink(tmp_path);
+		return 1;
+	}
+	return 0;
+}
+
+void rollup_free(struct rollup_tier *tier)
+{
+	free(tier->bucket);
+	tier->bucket = NULL;
+	tier->num = tier->cap = 0;
+}
@@ -0,0 +1,276 @@
+/* online statistics per logger, updated with each new data point */
+
+/*
+*  for temp and rh:
+*
+*   ewma  exponentially weighted moving average with time constant TAU,
+*         weight of a data point dt/(TAU+dt), so gaps count
+*   min   minimum of the last WINDOW seconds
+*   max   maximum of the last WINDOW seconds
+*   rate  change per hour, the slope between data points smoothed like ewma
+*
+*  min and max use monotonic deques: a new value drops all older values it
+*  makes irrelevant, the oldest value drops out when it leaves the window.
+*  so each data point costs O(1) amortized and the state is bounded by the
+*  number of data points in the window.
+*
+*  the state is kept in LOGNAME.stats and loaded before each update, data
+*  points not newer than the last one seen are skipped. so downloading the
+*  same log again, or following it, never needs the history.
+*/
+
+#define STATS_MAGIC "vdl120stats1"
+
+struct stats_deque {
+	long long *time;
+	short int *value;
+	int head, num, cap;             /* ring buffer */
+};
+
+struct stats_series {
+	double ewma;
+	double rate;                    /* per hour */
+	int last;                       /* last value, tenths */
+	struct stats_deque min;         /* increasing values */
+	struct stats_deque max;         /* decreasing values */
+};
+
+struct stats {
+	long long last_time;            /* -1 = no data yet */
+	int window;                     /* seconds */
+	int tau;                        /* seconds */
+	struct stats_series temp;
+	struct stats_series rh;
+};
+
+int stats_window = 0;   /* seconds, 0 = statistics off, set by -M */
+int stats_tau = 0;      /* seconds */
+pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int stats_add(struct config *cfg, struct data *data_first);
+
+
+void stats_deque_push_back(struct stats_deque *dq, long long time, int value)
+{
+	int i, k;
+
+	if (dq->num == dq->cap)
+	{
+		/* grow, unrolling the ring */
+		long long *time_new;
+		short int *value_new;
+		int cap = dq->cap ? dq->cap * 2 : 64;
+		time_new = malloc(cap * sizeof(long long));
+		value_new = malloc(cap * sizeof(short int));
+		for (i = 0; i < dq->num; i++)
+		{
+			k = (dq->head + i) % dq->cap;
+			time_new[i] = dq->time[k];
+			value_new[i] = dq->value[k];
+		}
+		free(dq->time);
+		free(dq->value);
+		dq->time = time_new;
+		dq->value = value_new;
+		dq->head = 0;
+		dq->cap = cap;
+	}
+	k = (dq->head + dq->num) % dq->cap;
+	dq->time[k] = time;
+	dq->value[k] = value;
+	dq->num++;
+}
+
+/* add a value, keeping the deque sorted: sign 1 for min, -1 for max */
+void stats_deque_add(struct stats_deque *dq, long long time, int value, int window, int sign)
+{
+	/* drop the values the new one makes irrelevant */
+	while (dq->num > 0 && sign * dq->value[(dq->head + dq->num - 1) % dq->cap] >= sign * value)
+		dq->num--;
+	stats_deque_push_back(dq, time, value);
+
+	/* drop what left the window */
+	while (dq->num > 0 && dq->time[dq->head] <= time - window)
+	{
+		dq->head = (dq->head + 1) % dq->cap;
+		dq->num--;
+	}
+}
+
+void stats_series_add(struct stats_series *s, long long dt, long long time, int value, struct stats *st)
+{
+	double alpha, slope;
+
+	if (dt < 0)
+	{
+		/* first data point */
+		s->ewma = value;
+		s->rate = 0;
+	}
+	else
+	{
+		alpha = (double)dt / (st->tau + dt);
+		slope = (value - s->last) * 3600.0 / (dt > 0 ? dt : 1);
+		s->ewma += alpha * (value - s->ewma);
+		s->rate += alpha * (slope - s->rate);
+	}
+	s->last = value;
+	stats_deque_add(&s->min, time, value, st->window, 1);
+	stats_deque_add(&s->max, time, value, st->window, -1);
+}
+
+void stats_deque_free(struct stats_deque *dq)
+{
+	free(dq->time);
+	free(dq->value);
+	memset(dq, 0, sizeof(*dq));
+}
+
+int stats_deque_load(FILE *file, struct stats_deque *dq)
+{
+	long long time;
+	int num, value, i;
+
+	if (1 != fscanf(file, "%d", &num))
+		return 1;
+	for (i = 0; i < num; i++)
+	{
+		if (2 != fscanf(file, "%lld %d", &time, &value))
+			return 1;
+		stats_deque_push_back(dq, time, value);
+	}
+	return 0;
+}
+
+void stats_deque_save(FILE *file, struct stats_deque *dq)
+{
+	int i, k;
+
+	fprintf(file, "%i\n", dq->num);
+	for (i = 0; i < dq->num; i++)
+	{
+		k = (dq->head + i) % dq->cap;
+		fprintf(file, "%lld %i\n", dq->time[k], dq->value[k]);
+	}
+}
+
+/* return value: 0 = loaded or no state yet, 1 = invalid state file */
+int stats_load(char *path, struct stats *st)
+{
+	FILE *file;
+	char magic[16];
+	int ret = 0;
+
+	memset(st, 0, sizeof(*st));
+	st->last_time = -1;
+
+	file = fopen(path, "r");
+	if (file == NULL)
+		return 0;
+	if (1 != fscanf(file, "%15s", magic) || 0 != strcmp(magic, STATS_MAGIC) ||
+		1 != fscanf(file, "%lld", &st->last_time) ||
+		3 != fscanf(file, "%lf %lf %d", &st->temp.ewma, &st->temp.rate, &st->temp.last) ||
+		0 != stats_deque_load(file, &st->temp.min) ||
+		0 != stats_deque_load(file, &st->temp.max) ||
+		3 != fscanf(file, "%lf %lf %d", &st->rh.ewma, &st->rh.rate, &st->rh.last) ||
+		0 != stats_deque_load(file, &st->rh.min) ||
+		0 != stats_deque_load(file, &st->rh.max))
+	{
+		printf("stats_load: invalid state in %s\n", path);
+		ret = 1;
+	}
+	fclose(file);
+	return ret;
+}
+
+int stats_save(char *path, struct stats *st)
+{
+	char tmp_path[1100];
+	FILE *file;
+
+	/* replace the state at once, a crash leaves the old one */
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	file = fopen(tmp_path, "w");
+	if (file == NULL)
+	{
+		printf("stats_save: failed to fopen(\"%s\", \"w\")\n", tmp_path);
+		return 1;
+	}
+	fprintf(file, "%s\n%lld\n", STATS_MAGIC, st->last_time);
+	fprintf(file, "%.17g %.17g %i\n", st->temp.ewma, st->temp.rate, st->temp.last);
+	stats_deque_save(file, &st->temp.min);
+	stats_deque_save(file, &st->temp.max);
+	fprintf(file, "%.17g %.17g %i\n", st->rh.ewma, st->rh.rate, st->rh.last);
+	stats_deque_save(file, &st->rh.min);
+	stats_deque_save(file, &st->rh.max);
+	if (0 != fclose(file) || 0 != rename(tmp_path, path))
+	{
+		printf("stats_save: failed to write %s\n", path);
+		unlink(tmp_path);
+		return 1;
+	}
+	return 0;
+}
+
+void stats_free(struct stats *st)
+{
+	stats_deque_free(&st->temp.min);
+	stats_deque_free(&st->temp.max);
+	stats_deque_free(&st->rh.min);
+	stats_deque_free(&st->rh.max);
+}
+
+int stats_add(struct config *cfg, struct data *data_first)
+{
+	struct stats st;
+	struct data *data_curr;
+	char path[64], *pos;
+	long long dt;
+	int num_new = 0, ret;
+
+	if (stats_window <= 0 || data_first == NULL)
+		return 0;
+
+	snprintf(path, sizeof(path), "%.16s.stats", config_name(cfg));
+	for (pos = path; *pos; pos++)
+		if (*pos == '/')
+			*pos = '_';
+
+	pthread_mutex_lock(&stats_lock);
+	if (0 != stats_load(path, &st))
+	{
+		stats_free(&st);
+		pthread_mutex_unlock(&stats_lock);
+		return 1;
+	}
+	st.window = stats_window;
+	st.tau = stats_tau > 0 ? stats_tau : stats_window;
+
+	for (data_curr = data_first; data_curr != NULL; data_curr = data_curr->next)
+	{
+		if (data_curr->time <= st.last_time)
+			continue;
+		dt = st.last_time < 0 ? -1 : data_curr->time - st.last_time;
+		stats_series_add(&st.temp, dt, data_curr->time, data_curr->temp, &st);
+		stats_series_add(&st.rh, dt, data_curr->time, data_curr->rh, &st);
+		st.last_time = data_curr->time;
+		num_new++;
+	}
+
+	ret = 0;
+	if (num_new > 0)
+	{
+		ret = stats_save(path, &st);
+		/* on stderr, -f prints the data on stdout */
+		fprintf(stderr, "stats: %.16s: temp %.1f ewma %.2f min %.1f max %.1f rate %+.2f/h,"
+			" rh %.1f ewma %.2f min %.1f max %.1f rate %+.2f/h\n",
+			config_name(cfg),
+			st.temp.last/10.0, st.temp.ewma/10.0, st.temp.min.value[st.temp.min.head]/10.0,
+			st.temp.max.value[st.temp.max.head]/10.0, st.temp.rate/10.0,
+			st.rh.last/10.0, st.rh.ewma/10.0, st.rh.min.value[st.rh.min.head]/10.0,
+			st.rh.max.value[st.rh.max.head]/10.0, st.rh.rate/10.0);
+	}
+	stats_free(&st);
+	pthread_mutex_unlock(&stats_lock);
+	return ret;
+}
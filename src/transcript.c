@@ -0,0 +1,218 @@
+/* record and replay usb bulk transfers */
+
+/*
+*  transcript file format, all numbers little endian:
+*
+*   8 bytes  magic "vdl120t1"
+*
+*  followed by one record per bulk transfer:
+*
+*   1 byte   direction: 'w' = host to logger, 'r' = logger to host
+*   1 byte   endpoint
+*   4 bytes  return value of usb_bulk_*: bytes transferred or error code
+*   8 bytes  microseconds since start of recording
+*   N bytes  transferred data, N = return value (0 on error)
+*/
+
+#define TRANSCRIPT_MAGIC "vdl120t1"
+#define TRANSCRIPT_HEADER 14
+
+FILE *transcript_out = NULL; /* recording to this file */
+FILE *transcript_in = NULL;  /* replaying from this file */
+int transcript_timing = 0;   /* bool: replay with the original timing */
+struct timespec transcript_start;
+
+/* the current replay record, consumed piecewise by transcript_read */
+char transcript_rec_dir = 0;
+int transcript_rec_ret = 0;
+long long transcript_rec_usec = 0;
+char transcript_rec_data[65536];
+int transcript_rec_pos = 0;
+
+int transcript_open(char *path, int replay);
+void transcript_close(void);
+void transcript_record(char dir, int ep, char *bytes, int ret);
+int transcript_write(int ep, char *bytes, int size);
+int transcript_read(int ep, char *bytes, int size);
+
+
+long long transcript_usec(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - transcript_start.tv_sec) * 1000000LL
+		+ (now.tv_nsec - transcript_start.tv_nsec) / 1000;
+}
+
+int transcript_open(char *path, int replay)
+{
+	char magic[8];
+
+	clock_gettime(CLOCK_MONOTONIC, &transcript_start);
+
+	if (replay)
+	{
+		transcript_in = fopen(path, "rb");
+		if (transcript_in == NULL)
+		{
+			printf("transcript_open: failed to fopen(\"%s\", \"rb\")\n", path);
+			return 1;
+		}
+		if (fread(magic, 1, 8, transcript_in) != 8 || memcmp(magic, TRANSCRIPT_MAGIC, 8) != 0)
+		{
+			printf("transcript_open: %s is not a transcript\n", path);
+			fclose(transcript_in); transcript_in = NULL;
+			return 1;
+		}
+		return 0;
+	}
+
+	transcript_out = fopen(path, "wb");
+	if (transcript_out == NULL)
+	{
+		printf("transcript_open: failed to fopen(\"%s\", \"wb\")\n", path);
+		return 1;
+	}
+	fwrite(TRANSCRIPT_MAGIC, 1, 8, transcript_out);
+	return 0;
+}
+
+void transcript_close(void)
+{
+	if (transcript_out != NULL)
+		fclose(transcript_out);
+	if (transcript_in != NULL)
+		fclose(transcript_in);
+	transcript_out = NULL;
+	transcript_in = NULL;
+}
+
+void transcript_record(char dir, int ep, char *bytes, int ret)
+{
+	unsigned char head[TRANSCRIPT_HEADER];
+	long long usec;
+	int i;
+
+	if (transcript_out == NULL)
+		return;
+
+	usec = transcript_usec();
+	head[0] = dir;
+	head[1] = ep & 0xFF;
+	for (i = 0; i < 4; i++)
+		head[2+i] = (ret >> (8*i)) & 0xFF;
+	for (i = 0; i < 8; i++)
+		head[6+i] = (usec >> (8*i)) & 0xFF;
+
+	fwrite(head, 1, TRANSCRIPT_HEADER, transcript_out);
+	if (ret > 0)
+		fwrite(bytes, 1, ret, transcript_out);
+}
+
+/* load the next record, return value: 0 = success, 1 = end of transcript */
+int transcript_next(void)
+{
+	unsigned char head[TRANSCRIPT_HEADER];
+	int i, len;
+
+	if (fread(head, 1, TRANSCRIPT_HEADER, transcript_in) != TRANSCRIPT_HEADER)
+		return 1;
+
+	transcript_rec_dir = head[0];
+	transcript_rec_ret = 0;
+	for (i = 0; i < 4; i++)
+		transcript_rec_ret |= head[2+i] << (8*i);
+	transcript_rec_usec = 0;
+	for (i = 0; i < 8; i++)
+		transcript_rec_usec |= (long long)head[6+i] << (8*i);
+	transcript_rec_pos = 0;
+
+	len = transcript_rec_ret > 0 ? transcript_rec_ret : 0;
+	if (len > (int)sizeof(transcript_rec_data) ||
+		fread(transcript_rec_data, 1, len, transcript_in) != (size_t)len)
+	{
+		printf("transcript_next: truncated record\n");
+		return 1;
+	}
+
+	if (transcript_timing)
+	{
+		/* wait until the transfer happened in the original session */
+		long long wait = transcript_rec_usec - transcript_usec();
+		struct timespec ts;
+		if (wait > 0)
+		{
+			ts.tv_sec = wait / 1000000;
+			ts.tv_nsec = (wait % 1000000) * 1000;
+			nanosleep(&ts, NULL);
+		}
+	}
+
+	return 0;
+}
+
+int transcript_write(int ep, char *bytes, int size)
+{
+	/* drop logger data the caller is not interested in anymore, */
+	/* e.g. when a newer vdl120 skips blocks the old one has read */
+
+	do {
+		if (transcript_next() != 0)
+			return -EPIPE;
+	} while (transcript_rec_dir != 'w');
+
+	if (transcript_rec_ret >= 0 &&
+		(transcript_rec_ret != size || memcmp(transcript_rec_data, bytes, size) != 0))
+	{
+		printf("transcript_write: request differs from the transcript\n");
+	}
+
+	return transcript_rec_ret;
+}
+
+int transcript_read(int ep, char *bytes, int size)
+{
+	int len, done = 0;
+
+	while (done < size)
+	{
+		if (transcript_rec_dir != 'r' || transcript_rec_pos >= transcript_rec_ret)
+		{
+			/* dont read into the next request */
+			if (done > 0 && transcript_rec_ret % BUFSIZE != 0)
+				break;
+
+			if (transcript_next() != 0)
+				return done > 0 ? done : -ETIMEDOUT;
+
+			if (transcript_rec_dir != 'r')
+			{
+				/* the session went on with a request, this read timed out */
+				printf("transcript_read: no more data before next request\n");
+				fseek(transcript_in, -(TRANSCRIPT_HEADER + (transcript_rec_ret > 0 ? transcript_rec_ret : 0)), SEEK_CUR);
+				transcript_rec_dir = 0;
+				return done > 0 ? done : -ETIMEDOUT;
+			}
+
+			if (transcript_rec_ret < 0)
+				return done > 0 ? done : transcript_rec_ret;
+
+			if (transcript_rec_ret == 0)
+				break;
+		}
+
+		len = transcript_rec_ret - transcript_rec_pos;
+		if (len > size - done)
+			len = size - done;
+		memcpy(bytes + done, transcript_rec_data + transcript_rec_pos, len);
+		transcript_rec_pos += len;
+		done += len;
+
+		/* a short packet ends the transfer */
+		if (transcript_rec_pos == transcript_rec_ret && transcript_rec_ret % BUFSIZE != 0)
+			break;
+	}
+
+	return done;
+}
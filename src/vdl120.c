@@ -6,30 +6,78 @@
 *   + read configuration
 *   + read log data
 *   + store log data for plotting
+*   + follow a recording logger
+*   + record and replay usb transcripts
+*   + export log data to Apache Arrow files
+*   + export stored data as gnuplot binary files with a plot script
+*   + export log data to SQLite databases
+*   + render log data as SVG or PNG chart
+*   + join the data of several loggers on a common time grid
+*   + rotate logs: store and re-arm the logger before it is full
+*   + fleet mode: rotate many loggers on several usb busses
+*   + hotplug mode: download loggers as soon as they are plugged in
+*   + per logger calibration
+*   + send data to InfluxDB as line protocol
+*   + online statistics: moving average, rolling min/max, rate of change
+*   + percentiles and time in bands over archives, from histogram sketches
+*   + roll old data up into hourly and daily aggregates
+*   + download and store at once: usb, decoding and writing overlap
+*   + watch mode: threshold alarms with hysteresis, reported to a hook
+*   + latest readings of all loggers in shared memory, for local readers
+*   + crash-safe archive: checksummed sessions, shared syncs
+*   + skip the download of logs already stored
+*   + tag stuck, spiking and out of range data points while downloading
 *
 *  DEPENDENCIES
 *
 *   + libusb-0.1
+*   + sqlite3
 *
 *  TODO
 *
 *   + port to libusb-1.x
-*   + dont rely on the host's byte order (endianness)
-*   + clean up: wrap usb_bulk_* functions + error handling
+*   + clean up: error handling
 *   + find a better 'num2bin' algorithm
 *   + more config options (?)
 *
 */
 
 
+#define _GNU_SOURCE /* syncfs */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <strings.h>
 #include <unistd.h>
 #include <usb.h>
 #include <time.h>
+#include <errno.h>
+#include <endian.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sqlite3.h>
 
+#include "vdl120shm.h"
 #include "num2bin.c"
+#include "config.c"
+#include "calib.c"
+#include "arrow.c"
+#include "gnuplot.c"
+#include "render.c"
+#include "join.c"
+#include "ring.c"
 
 
 /* hardware specs */
@@ -39,9 +87,11 @@
 #define PID2 0xea61
 //#define EP_IN  0x81
 //#define EP_OUT 0x02
-int EP_IN = 0;
-int EP_OUT = 0;
+__thread int EP_IN = 0;  /* per thread, see fleet_data */
+__thread int EP_OUT = 0;
+__thread char logger_location[32] = ""; /* "usb:BUS/DEVICE" of the open logger, see calib.c */
 #define BUFSIZE 64 /* wMaxPacketSize = 1x 64 bytes */
+#define BLOCKSIZE 4096 /* data is sent in blocks of 1024 data points, 4 bytes each */
 #define TIMEOUT 5000
 #define TEMP_MIN -40 /* same with celsius and fahrenheit */
 #define TEMP_MAX_C 70
@@ -51,46 +101,58 @@ int EP_OUT = 0;
 
 #define ERR(...) do { fprintf(stderr, "ERR: %s:%d: ", __FILE__, __LINE__); fprintf(stderr, __VA_ARGS__); } while (0)
 
+#include "transcript.c"
 
-/* struct definitions */
 
-struct config {
-/*  0- 3 */  int config_begin; /* 0xce = set config, 0x00 = logger is active */
-/*  4- 7 */  int num_data_conf; /* number of data configured */
-/*  8-11 */  int num_data_rec; /* number of data recorded */
-/* 12-15 */  int interval; /* log interval in seconds */
-/* 16-19 */  int time_year;
-/* 20-21 */  short int padding20;
-/* 22-23 */  short int thresh_temp_low;
-/* 24-25 */  short int padding24;
-/* 26-27 */  short int thresh_temp_high;
-/* 28    */  char time_mon; /* start time, local (!) timezone */
-/* 29    */  char time_mday;
-/* 30    */  char time_hour;
-/* 31    */  char time_min;
-/* 32    */  char time_sec;
-/* 33    */  char temp_is_fahrenheit;
-/* 34    */  char led_conf; /* bit 0: alarm on/off, bits 1-2: 10 (?), bits 3-7: flash frequency in seconds */
-// 35 ?!
-/* 35-50 */  char name[16]; /* config name. actually just 16 bytes: 35-50 */
-/* 51    */  char start; /* 0x02 = start logging immediately; 0x01 = start logging manually */
-/* 52-53 */  short int padding52;
-/* 54-55 */  short int thresh_rh_low;
-/* 56-57 */  short int padding56;
-/* 58-59 */  short int thresh_rh_high;
-/* 60-63 */  int config_end; /* = config_begin */
-};
+/* struct definitions */
 
 struct data {
-	short int temp; /* temperature in °C or °F, check cfg->temp_is_fahrenheit */
+	short int temp; /* temperature in °C or °F, check config_temp_is_fahrenheit(cfg) */
 	short int rh; /* relative humidity in % */
+	short int temp_raw; /* as sent by the logger, before calibration */
+	short int rh_raw;
+	unsigned char fault; /* FAULT_* bits of a suspect data point, see fault.c */
 	time_t time; /* timestamp, unix time, GMT (!) timezone */
 	struct data *next; /* next data set or NULL */
 };
 
+#include "influx.c"
+#include "stats.c"
+#include "hist.c"
+#include "fault.c"
+#include "archive.c"
+#include "rollup.c"
+#include "alarm.c"
+#include "live.c"
+#include "catalog.c"
+#include "db.c"
+
 
 /* function prototypes */
 
+int                                 /* return value: bytes written or error code */
+bulk_write(
+	struct usb_dev_handle *dev_hdl, /* usb dev handle */
+	int ep,                         /* endpoint */
+	char *bytes,                    /* data to write */
+	int size,                       /* number of bytes to write */
+	int timeout                     /* timeout in milliseconds */
+);
+
+int                                 /* return value: bytes read or error code */
+bulk_read(
+	struct usb_dev_handle *dev_hdl, /* usb dev handle */
+	int ep,                         /* endpoint */
+	char *bytes,                    /* buffer to read into */
+	int size,                       /* buffer size */
+	int timeout                     /* timeout in milliseconds */
+);
+
+struct usb_dev_handle *             /* return value: usb dev handle, NULL = failed */
+open_logger(
+	struct usb_device *dev          /* usb device found by enumeration */
+);
+
 struct config *                     /* return value: config struct */
 read_config(
 	struct usb_dev_handle *dev_hdl  /* usb dev handle */
@@ -128,26 +190,318 @@ check_config(
 	struct config *cfg /* config struct */
 );
 
+int                    /* return value: number of arguments, -1 = unknown command */
+command_args(
+	char *command      /* command line switch, e.g. "-c" */
+);
+
 struct data *                       /* return value: first data struct */
 read_data(
 	struct usb_dev_handle *dev_hdl, /* usb dev handle */
 	struct config *cfg              /* config struct */
 );
 
+struct data *                       /* return value: first data struct */
+read_data_from(
+	struct usb_dev_handle *dev_hdl, /* usb dev handle */
+	struct config *cfg,             /* config struct */
+	int first                       /* index of the first data point to return */
+);
+
+int                                 /* return value: 0 = success */
+read_block(
+	struct usb_dev_handle *dev_hdl, /* usb dev handle */
+	int request,                    /* 0x00 = dump from the start, 0x01 = next block, -1 = requested already */
+	int num_block,                  /* number of data points in the block */
+	char *block,                    /* gets the data, BLOCKSIZE + BUFSIZE bytes */
+	int *num_transfers              /* counts the usb transfers */
+);
+
+void
+decode_block(
+	char *block,                    /* as read by read_block */
+	int num_block,                  /* number of data points in the block */
+	struct calib *cal,              /* calibration, NULL = none */
+	short int *temp,                /* get the calibrated values */
+	short int *rh,
+	short int *temp_raw,            /* get the values as sent */
+	short int *rh_raw
+);
+
+struct data *                       /* return value: first data struct, NULL = failed */
+read_store_data(
+	struct usb_dev_handle *dev_hdl, /* usb dev handle */
+	struct config *cfg              /* config struct */
+);
+
 void
-print_data(
+free_data(
 	struct data *data_first
 );
 
 void
+print_data(
+	struct data *data_first
+);
+
+int                                 /* return value: 0 = success */
+follow_data(
+	struct usb_dev_handle *dev_hdl  /* usb dev handle */
+);
+
+time_t                              /* return value: start time, local (!) timezone */
+config_start_time(
+	struct config *cfg              /* config struct */
+);
+
+long long                           /* return value: seconds until the logger is full, 0 = full */
+rotate_wait(
+	struct config *cfg              /* config struct */
+);
+
+long long                           /* return value: seconds to sleep before checking again */
+rotate_sleep(
+	long long wait,                 /* seconds until the logger is full */
+	int margin                      /* seconds to wake up before */
+);
+
+int                                 /* return value: 0 = success */
+rotate_log(
+	struct usb_dev_handle *dev_hdl, /* usb dev handle */
+	struct config *cfg              /* config struct, as read right before */
+);
+
+int                                 /* return value: 0 = success */
+rotate_data(
+	struct usb_dev_handle *dev_hdl, /* usb dev handle */
+	int margin                      /* wake up this many seconds before the logger is full */
+);
+
+int                    /* return value: 0 = success */
+fleet_data(
+	int per_bus,       /* max transfers per usb bus */
+	int margin         /* rotate this many seconds before a logger is full */
+);
+
+int                    /* return value: 0 = success */
+hotplug_data(
+	int rearm          /* bool: start a new log after the download */
+);
+
+int                    /* return value: 0 = success */
+watch_data(
+	char *hook,        /* fifo or shell command */
+	double hysteresis, /* in °C, °F or % */
+	int holdoff        /* min seconds between hooks per logger and quantity */
+);
+
+int                    /* return value: 0 = success */
+publish_data(
+	struct config *cfg,
+	struct data *data_first /* new data of this logger */
+);
+
+int                    /* return value: 0 = success */
 store_data(
 	struct config *cfg,
 	struct data *data_first
 );
 
+int                    /* return value: 0 = success */
+store_begin(
+	struct config *cfg,
+	struct store *st   /* gets LOGNAME.dat, opened with the session header written */
+);
+
+void
+store_point(
+	struct store *st,  /* as set up by store_begin */
+	struct data *data_curr /* kept until the next call, NULL = write the last one */
+);
+
+int                    /* return value: 0 = success */
+store_end(
+	struct config *cfg,
+	struct store *st,  /* as set up by store_begin, closed */
+	struct data *data_first /* the data stored */
+);
+
+void
+store_abort(
+	struct store *st   /* as set up by store_begin, closed, the session removed */
+);
+
+struct data *          /* return value: first data struct, NULL = end of file */
+load_data(
+	FILE *dumpfile,    /* file written by store_data */
+	struct config *cfg /* config struct, gets start time, number of data and interval */
+);
+
+int                    /* return value: 0 = success */
+store_arrow(
+	struct config *cfg,
+	struct data *data_first,
+	char *path
+);
+
+int                    /* return value: 0 = success */
+convert_arrow(
+	char *dumpfile_path /* file written by store_data */
+);
+
+int                    /* return value: 0 = success */
+convert_gnuplot(
+	char *dumpfile_path /* file written by store_data */
+);
+
+int                    /* return value: 0 = success */
+store_db(
+	struct config *cfg,
+	struct data *data_first,
+	char *path          /* SQLite database */
+);
+
+int                    /* return value: 0 = success */
+convert_db(
+	char *dumpfile_path, /* file written by store_data */
+	char *path           /* SQLite database */
+);
+
+int                    /* return value: 0 = success */
+render_data(
+	struct config *cfg,
+	struct data *data_first,
+	char *path          /* .svg or .png file */
+);
+
+int                    /* return value: 0 = success */
+render_archive(
+	char *dumpfile_path, /* file written by store_data */
+	char *path           /* .svg or .png file */
+);
+
+int                    /* return value: 0 = success */
+join_data(
+	char *sources,      /* comma separated .dat files, "-" = downloaded data */
+	char *method,       /* nearest, linear or last */
+	int step,           /* grid step in seconds, 0 = all timestamps */
+	struct config *cfg,
+	struct data *data_first
+);
+
+int                    /* return value: 0 = success */
+sketch_archive(
+	char *dumpfile_path, /* file written by store_data */
+	int fahrenheit       /* bool: temp in °F, the .dat file does not tell */
+);
+
+int                    /* return value: 0 = success */
+query_sketches(
+	char *from,         /* first day, YYYY-MM-DD, "-" = no limit */
+	char *to,           /* day after the last day, YYYY-MM-DD, "-" = no limit */
+	char *bands,        /* e.g. temp:2:8,rh:30:60, "-" = none */
+	char *paths         /* comma separated .hist files */
+);
+
+int                    /* return value: 0 = success */
+compact_archive(
+	char *dumpfile_path, /* file written by store_data */
+	int days,            /* roll up sessions older than this */
+	int keep             /* bool: keep them in dumpfile_path, too */
+);
+
+int                    /* return value: 0 = success */
+query_rollup(
+	char *from,          /* first day, YYYY-MM-DD, "-" = no limit */
+	char *to,            /* day after the last day, YYYY-MM-DD, "-" = no limit */
+	int step,            /* bucket width in seconds */
+	char *dumpfile_path  /* file written by store_data */
+);
+
 
 /* function implementations */
 
+struct usb_dev_handle *             /* return value: usb dev handle, NULL = failed */
+open_logger(
+	struct usb_device *dev          /* usb device found by enumeration */
+) {
+	struct usb_dev_handle *dev_hdl;
+	int ret;
+	
+	dev_hdl = usb_open(dev);
+	if (dev_hdl == NULL)
+	{
+		printf("usb_open failed: %s\n", usb_strerror());
+		return NULL;
+	}
+	EP_OUT = dev->config[0].interface[0].altsetting[0].endpoint[0].bEndpointAddress;
+	EP_IN = dev->config[0].interface[0].altsetting[0].endpoint[1].bEndpointAddress;
+	snprintf(logger_location, sizeof(logger_location), "usb:%.12s/%.12s", dev->bus->dirname, dev->filename);
+	
+	ret = usb_reset(dev_hdl);
+	if (ret < 0)
+	{
+		printf("usb_reset failed with status %i: %s\n", ret, usb_strerror());
+		usb_close(dev_hdl);
+		return NULL;
+	}
+	
+	ret = usb_set_configuration(dev_hdl, 1); // bConfigurationValue=1, iConfiguration=0
+	if (ret < 0)
+	{
+		printf("usb_set_configuration failed with status %i\n", ret);
+		usb_close(dev_hdl);
+		return NULL;
+	}
+	
+	ret = usb_claim_interface(dev_hdl, 0); // bInterfaceNumber=0, bAlternateSetting=0, bNumEndpoints=2
+	if (ret < 0)
+	{
+		printf("usb_claim_interface failed with status %i: %s\n", ret, usb_strerror());
+		usb_close(dev_hdl);
+		return NULL;
+	}
+	
+	return dev_hdl;
+}
+
+
+int                                 /* return value: bytes written or error code */
+bulk_write(
+	struct usb_dev_handle *dev_hdl, /* usb dev handle */
+	int ep,                         /* endpoint */
+	char *bytes,                    /* data to write */
+	int size,                       /* number of bytes to write */
+	int timeout                     /* timeout in milliseconds */
+) {
+	int ret;
+	
+	if (transcript_in != NULL)
+		return transcript_write(ep, bytes, size);
+	
+	ret = usb_bulk_write(dev_hdl, ep, bytes, size, timeout);
+	transcript_record('w', ep, bytes, ret);
+	return ret;
+}
+
+int                                 /* return value: bytes read or error code */
+bulk_read(
+	struct usb_dev_handle *dev_hdl, /* usb dev handle */
+	int ep,                         /* endpoint */
+	char *bytes,                    /* buffer to read into */
+	int size,                       /* buffer size */
+	int timeout                     /* timeout in milliseconds */
+) {
+	int ret;
+	
+	if (transcript_in != NULL)
+		return transcript_read(ep, bytes, size);
+	
+	ret = usb_bulk_read(dev_hdl, ep, bytes, size, timeout);
+	transcript_record('r', ep, bytes, ret);
+	return ret;
+}
+
 struct config *                     /* return value: config struct */
 read_config(
 	struct usb_dev_handle *dev_hdl  /* usb dev handle */
@@ -163,7 +517,7 @@ read_config(
 	buf[1] = 0x10;
 	buf[2] = 0x01;
 	
-	ret = usb_bulk_write(
+	ret = bulk_write(
 		dev_hdl,
 		EP_OUT,
 		buf,
@@ -179,7 +533,7 @@ read_config(
 	
 	/* read response header (3 bytes) */
 	
-	ret = usb_bulk_read(
+	ret = bulk_read(
 		dev_hdl,
 		EP_IN,
 		buf,
@@ -208,18 +562,26 @@ read_config(
 	
 	/* read response data (64 byte) */
 	
+	/* straight into the wire buffer, see config.c */
+	
 	cfg = malloc(sizeof(struct config));
+	if (cfg == NULL)
+	{
+		printf("read_config: failed to malloc struct config\n");
+		return NULL;
+	}
 	
-	ret = usb_bulk_read(
+	ret = bulk_read(
 		dev_hdl,
 		EP_IN,
-		(char *)cfg,
-		64,
+		(char *)cfg->buf,
+		CONFIG_SIZE,
 		TIMEOUT
 	);
 	if (ret < 0)
 	{
 		ERR("usb_bulk_read failed with code %i: %s\n", ret, usb_strerror());
+		free(cfg);
 		return NULL;
 	}
 	
@@ -242,7 +604,7 @@ write_config(
 	buf[1] = 0x40;
 	buf[2] = 0x00;
 	
-	ret = usb_bulk_write(
+	ret = bulk_write(
 		dev_hdl,
 		EP_OUT,
 		buf,
@@ -269,11 +631,11 @@ write_config(
 	printf("\n");
 */
 	
-	ret = usb_bulk_write(
+	ret = bulk_write(
 		dev_hdl,
 		EP_OUT,
-		(char *)cfg,
-		64,
+		(char *)cfg->buf,
+		CONFIG_SIZE,
 		TIMEOUT
 	);
 	if (ret < 0)
@@ -284,7 +646,7 @@ write_config(
 	
 	/* read response code (1 byte) */
 	
-	ret = usb_bulk_read(
+	ret = bulk_read(
 		dev_hdl,
 		EP_IN,
 		buf,
@@ -311,10 +673,26 @@ read_data(
 	struct usb_dev_handle *dev_hdl, /* usb dev handle */
 	struct config *cfg              /* config struct */
 ) {
+	return read_data_from(dev_hdl, cfg, 0);
+}
+
+struct data *                       /* return value: first data struct */
+read_data_from(
+	struct usb_dev_handle *dev_hdl, /* usb dev handle */
+	struct config *cfg,             /* config struct */
+	int first                       /* index of the first data point to return */
+) {
 	
 	char buf[BUFSIZE];
-	//char buf[1024];
-	int ret, i, num_data;
+	char block[BLOCKSIZE + BUFSIZE]; /* one block of data points + room for a padded packet */
+	short int temp[BLOCKSIZE / 4], rh[BLOCKSIZE / 4];
+	short int temp_raw[BLOCKSIZE / 4], rh_raw[BLOCKSIZE / 4];
+	int ret, i, num_data, num_skip, num_block;
+	int num_transfers = 0;
+	struct timespec time_begin, time_end;
+	struct calib *cal;
+	struct fault fault;
+	char summary[128];
 	
 	struct data *data_first = NULL;
 	struct data *data_last  = NULL;
@@ -332,17 +710,28 @@ read_data(
 		}
 	}
 	
-	if (cfg->num_data_rec == 0)
+	cal = calib_find(config_name(cfg), logger_location);
+	fault_init(&fault, config_temp_is_fahrenheit(cfg));
+	
+	if (config_num_data_rec(cfg) == 0)
 	{
 		printf("read_data: no data to read\n");
 		return NULL;
 	}
 	
+	if (first < 0 || config_num_data_rec(cfg) <= first)
+	{
+		printf("read_data: no data to read after data point %i\n", first);
+		return NULL;
+	}
+	
+	clock_gettime(CLOCK_MONOTONIC, &time_begin);
+	
 	buf[0] = 0x00;
 	buf[1] = 0x00;
 	buf[2] = 0x40;
 	
-	ret = usb_bulk_write(
+	ret = bulk_write(
 		dev_hdl,
 		EP_OUT,
 		buf,
@@ -354,85 +743,24 @@ read_data(
 		printf("usb_bulk_write failed with code %i: %s\n", ret, usb_strerror());
 		return NULL;
 	}
-	
-	struct tm *time_start;
-	time_start = malloc(sizeof(struct tm));
-	memset(time_start, 0, sizeof(struct tm));
-	time_start->tm_year = -1900 + cfg->time_year;
-	time_start->tm_mon  = -1 + cfg->time_mon;
-	time_start->tm_mday = cfg->time_mday;
-	time_start->tm_hour = cfg->time_hour;
-	time_start->tm_min  = cfg->time_min;
-	time_start->tm_sec  = cfg->time_sec;
-	time_start->tm_isdst = -1;
+	num_transfers++;
 	
 	time_t time_start_stamp;
 	
 	// create GMT timestamps for Gnuplot
-	setenv("TZ", "GMT", 1);
-	time_start_stamp = mktime(time_start);
-	unsetenv("TZ");
+	time_start_stamp = config_start_time(cfg);
 	
-	num_data = 0;
-	while (num_data < cfg->num_data_rec)
+	/* skip the blocks before the one containing data point 'first': */
+	/* take the response header of each block, but request the next */
+	/* block right away instead of reading 1024 data points we dont need */
+	
+	for (num_skip = 0; num_skip < first / 1024; num_skip++)
 	{
-		
-		/* send (random?) keep-alive packet every 1024 bytes */
-		/* the logger sends another response header before further data */
-		
-		if (num_data > 0 && num_data % 1024 == 0)
-		{
-			buf[0] = 0x00;
-			buf[1] = 0x01;
-			buf[2] = 0x40;
-			ret = usb_bulk_write(
-				dev_hdl,
-				EP_OUT,
-				buf,
-				3,
-				TIMEOUT
-			);
-			if (ret < 0)
-			{
-				printf("usb_bulk_write failed with code %i: %s\n", ret, usb_strerror());
-				return NULL;
-			}
-		}
-		
-		/* read response header (3 bytes) */
-		
-		if (num_data % 1024 == 0)
-		{
-			ret = usb_bulk_read(
-				dev_hdl,
-				EP_IN,
-				buf,
-				3,
-				TIMEOUT
-			);
-			if (ret < 0)
-			{
-				ERR("usb_bulk_read failed with code %i: %s\n", ret, usb_strerror());
-				return NULL;
-			}
-/*
-			printf("read_data: response header:");
-			for (i=0; i<ret; i++)
-			{
-				printf(" %02x", 0xFF & buf[i]);
-			}
-			printf("\n");
-*/
-		}
-		
-		
-		/* read response data (64 byte) */
-		
-		ret = usb_bulk_read(
+		ret = bulk_read(
 			dev_hdl,
 			EP_IN,
 			buf,
-			64, // 1024
+			3,
 			TIMEOUT
 		);
 		if (ret < 0)
@@ -440,139 +768,2668 @@ read_data(
 			ERR("usb_bulk_read failed with code %i: %s\n", ret, usb_strerror());
 			return NULL;
 		}
-
-/*
-		printf("read_data: response data:");
-		for (i=0; i<ret; i++)
+		
+		buf[0] = 0x00;
+		buf[1] = 0x01;
+		buf[2] = 0x40;
+		ret = bulk_write(
+			dev_hdl,
+			EP_OUT,
+			buf,
+			3,
+			TIMEOUT
+		);
+		if (ret < 0)
 		{
-			if (i % 8 == 0)
-				printf("\n   ");
-			printf(" %02x", 0xFF & buf[i]);
+			printf("usb_bulk_write failed with code %i: %s\n", ret, usb_strerror());
+			return NULL;
 		}
-		printf("\n");
-*/
+		num_transfers += 2;
+	}
+	
+	num_data = num_skip * 1024;
+	while (num_data < config_num_data_rec(cfg))
+	{
 		
+		num_block = config_num_data_rec(cfg) - num_data;
+		if (num_block > 1024)
+			num_block = 1024;
 		
-		/* parse data: 4 bytes per data point (64/4=16) */
+		/* request the next block, except for the first one */
+		if (0 != read_block(dev_hdl, num_data > num_skip * 1024 ? 0x01 : -1, num_block, block, &num_transfers))
+			return NULL;
+		decode_block(block, num_block, cal, temp, rh, temp_raw, rh_raw);
 		
-		//for (i = 0; i < 16; i++)
-		for (i = 0; i < ret/4; i++)
+		for (i = 0; i < num_block; i++, num_data++)
 		{
+			if (num_data < first)
+				continue;
+			
 			data_curr = malloc(sizeof(struct data));
-			memcpy((char *)data_curr, (char *)buf+i*4, 4);
-			data_curr->time = time_start_stamp + num_data * cfg->interval;
+			data_curr->temp = temp[i];
+			data_curr->rh = rh[i];
+			data_curr->temp_raw = temp_raw[i];
+			data_curr->rh_raw = rh_raw[i];
+			data_curr->time = time_start_stamp + num_data * config_interval(cfg);
 			data_curr->next = NULL;
+			fault_add(&fault, data_curr);
 			
-			if (num_data == 0)
+			if (num_data == first)
 				data_first = data_curr;
 			else
 				data_last->next = data_curr;
 			data_last = data_curr;
-			
-			num_data++;
-			if (num_data == cfg->num_data_rec)
-				break;
 		}
 	}
-
-printf("num_data = %i\n", num_data);
+	fault_end(&fault);
+	
+	clock_gettime(CLOCK_MONOTONIC, &time_end);
+
+	/* on stderr, -f and -w print the data on stdout */
+	fprintf(stderr, "num_data = %i (%i usb transfers, %.3f sec)\n", num_data - first, num_transfers,
+		time_end.tv_sec - time_begin.tv_sec + (time_end.tv_nsec - time_begin.tv_nsec) / 1e9);
+	
+	if (fault_summary(&fault, summary, sizeof(summary)) > 0)
+		fprintf(stderr, "%.16s: %s\n", config_name(cfg), summary);
+	
+	return data_first;
+}	
+
+
+int                                 /* return value: 0 = success */
+read_block(
+	struct usb_dev_handle *dev_hdl, /* usb dev handle */
+	int request,                    /* 0x00 = dump from the start, 0x01 = next block, -1 = requested already */
+	int num_block,                  /* number of data points in the block */
+	char *block,                    /* gets the data, BLOCKSIZE + BUFSIZE bytes */
+	int *num_transfers              /* counts the usb transfers */
+) {
+	char buf[BUFSIZE];
+	int ret, size;
+	
+	/* send (random?) keep-alive packet every 1024 data points */
+	/* the logger sends another response header before further data */
+	
+	if (request >= 0)
+	{
+		buf[0] = 0x00;
+		buf[1] = request;
+		buf[2] = 0x40;
+		ret = bulk_write(
+			dev_hdl,
+			EP_OUT,
+			buf,
+			3,
+			TIMEOUT
+		);
+		if (ret < 0)
+		{
+			printf("usb_bulk_write failed with code %i: %s\n", ret, usb_strerror());
+			return 1;
+		}
+		(*num_transfers)++;
+	}
+	
+	/* read response header (3 bytes) */
+	
+	ret = bulk_read(
+		dev_hdl,
+		EP_IN,
+		buf,
+		3,
+		TIMEOUT
+	);
+	if (ret < 0)
+	{
+		ERR("usb_bulk_read failed with code %i: %s\n", ret, usb_strerror());
+		return 1;
+	}
+	(*num_transfers)++;
+	
+	/* read response data: the whole block in as few transfers as */
+	/* possible. always ask for whole packets, the logger may pad the */
+	/* last one. a short packet ends a transfer early, even in the */
+	/* middle of a data point, so just go on reading behind it. */
+	
+	size = 0;
+	while (size < num_block * 4)
+	{
+		ret = bulk_read(
+			dev_hdl,
+			EP_IN,
+			block + size,
+			(num_block * 4 - size + BUFSIZE - 1) / BUFSIZE * BUFSIZE,
+			TIMEOUT
+		);
+		if (ret < 0)
+		{
+			ERR("usb_bulk_read failed with code %i: %s\n", ret, usb_strerror());
+			return 1;
+		}
+		if (ret == 0)
+		{
+			ERR("read_data: block ended after %i of %i bytes\n", size, num_block * 4);
+			return 1;
+		}
+		size += ret;
+		(*num_transfers)++;
+	}
+	return 0;
+}
+
+
+void
+decode_block(
+	char *block,                    /* as read by read_block */
+	int num_block,                  /* number of data points in the block */
+	struct calib *cal,              /* calibration, NULL = none */
+	short int *temp,                /* get the calibrated values */
+	short int *rh,
+	short int *temp_raw,            /* get the values as sent */
+	short int *rh_raw
+) {
+	int i;
+	
+	/* parse data: 4 bytes per data point, temp and rh little endian */
+	
+	for (i = 0; i < num_block; i++)
+	{
+		temp[i] = temp_raw[i] = (block[i*4] & 0xFF) | block[i*4+1] << 8;
+		rh[i]   = rh_raw[i]   = (block[i*4+2] & 0xFF) | block[i*4+3] << 8;
+	}
+	
+	/* calibrate the whole block at once */
+	calib_apply(cal, temp, rh, num_block);
+}
+
+
+/* download pipeline: usb reader thread --> decoder thread --> writer */
+
+/*
+*  the stages pass blocks of 1024 data points through lock-free rings,
+*  see ring.c. the blocks come from a fixed pool and go back to the
+*  reader once written, so nothing is allocated per block. while the
+*  reader waits for usb, the decoder and the writer work on the blocks
+*  before. a block with num_data 0 ends the download, -1 aborts it.
+*/
+
+#define PIPE_BLOCKS 8
+
+struct pipe_block {
+	int num_data;                   /* data points in the block, 0 = end, -1 = failed */
+	int index;                      /* of the first data point */
+	char raw[BLOCKSIZE + BUFSIZE];
+	short int temp[BLOCKSIZE / 4], rh[BLOCKSIZE / 4];
+	short int temp_raw[BLOCKSIZE / 4], rh_raw[BLOCKSIZE / 4];
+};
+
+struct pipe {
+	struct usb_dev_handle *dev_hdl;
+	struct config *cfg;
+	struct calib *cal;
+	int ep_in, ep_out;              /* EP_IN and EP_OUT are per thread */
+	int num_transfers;              /* written by the reader only */
+	struct ring empty;              /* writer --> reader */
+	struct ring filled;             /* reader --> decoder */
+	struct ring decoded;            /* decoder --> writer */
+	struct pipe_block block[PIPE_BLOCKS];
+};
+
+
+void *
+pipe_read(
+	void *arg                       /* struct pipe */
+) {
+	struct pipe *p = arg;
+	struct pipe_block *b;
+	int num_data = 0, num_block;
+	
+	EP_IN = p->ep_in;
+	EP_OUT = p->ep_out;
+	
+	/* once pushed, the block belongs to the decoder */
+	do {
+		b = ring_pop_wait(&p->empty);
+		num_block = config_num_data_rec(p->cfg) - num_data;
+		if (num_block > 1024)
+			num_block = 1024;
+		if (num_block > 0 &&
+			0 != read_block(p->dev_hdl, num_data == 0 ? 0x00 : 0x01, num_block, b->raw, &p->num_transfers))
+			num_block = -1;
+		b->index = num_data;
+		b->num_data = num_block;
+		num_data += num_block;
+		ring_push_wait(&p->filled, b);
+	} while (num_block > 0);
+	return NULL;
+}
+
+
+void *
+pipe_decode(
+	void *arg                       /* struct pipe */
+) {
+	struct pipe *p = arg;
+	struct pipe_block *b;
+	int num_data;
+	
+	/* once pushed, the block belongs to the writer */
+	do {
+		b = ring_pop_wait(&p->filled);
+		num_data = b->num_data;
+		if (num_data > 0)
+			decode_block(b->raw, num_data, p->cal, b->temp, b->rh, b->temp_raw, b->rh_raw);
+		ring_push_wait(&p->decoded, b);
+	} while (num_data > 0);
+	return NULL;
+}
+
+
+struct data *                       /* return value: first data struct, NULL = failed */
+read_store_data(
+	struct usb_dev_handle *dev_hdl, /* usb dev handle */
+	struct config *cfg              /* config struct */
+) {
+	struct pipe *p;
+	struct pipe_block *b;
+	struct data *data_first = NULL, *data_last = NULL, *data_curr, *result = NULL;
+	pthread_t reader, decoder;
+	time_t time_start_stamp;
+	struct store st;
+	int num_data = 0, failed = 0, have_decoder = 1, i;
+	
+	if (config_num_data_rec(cfg) == 0)
+	{
+		printf("read_data: no data to read\n");
+		return NULL;
+	}
+	
+	p = calloc(1, sizeof(struct pipe));
+	if (p == NULL)
+		return NULL;
+	if (0 != ring_init(&p->empty, PIPE_BLOCKS) ||
+		0 != ring_init(&p->filled, PIPE_BLOCKS) ||
+		0 != ring_init(&p->decoded, PIPE_BLOCKS))
+		goto abort;
+	p->dev_hdl = dev_hdl;
+	p->cfg = cfg;
+	p->cal = calib_find(config_name(cfg), logger_location);
+	p->ep_in = EP_IN;
+	p->ep_out = EP_OUT;
+	for (i = 0; i < PIPE_BLOCKS; i++)
+		ring_push(&p->empty, &p->block[i]);
+	
+	if (0 != store_begin(cfg, &st))
+		goto abort;
+	
+	time_start_stamp = config_start_time(cfg);
+	
+	if (0 != pthread_create(&reader, NULL, pipe_read, p))
+	{
+		printf("read_store_data: failed to start reader thread\n");
+		store_abort(&st);
+		goto abort;
+	}
+	if (0 != pthread_create(&decoder, NULL, pipe_decode, p))
+	{
+		/* decode in this thread, after the reader */
+		printf("read_store_data: failed to start decoder thread\n");
+		have_decoder = 0;
+	}
+	
+	/* the writer stage: store and link the data points */
+	
+	while (1)
+	{
+		if (have_decoder)
+			b = ring_pop_wait(&p->decoded);
+		else
+		{
+			b = ring_pop_wait(&p->filled);
+			if (b->num_data > 0)
+				decode_block(b->raw, b->num_data, p->cal, b->temp, b->rh, b->temp_raw, b->rh_raw);
+		}
+		if (b->num_data <= 0)
+		{
+			failed = b->num_data < 0;
+			break;
+		}
+		for (i = 0; i < b->num_data; i++, num_data++)
+		{
+			data_curr = malloc(sizeof(struct data));
+			data_curr->temp = b->temp[i];
+			data_curr->rh = b->rh[i];
+			data_curr->temp_raw = b->temp_raw[i];
+			data_curr->rh_raw = b->rh_raw[i];
+			data_curr->time = time_start_stamp + (b->index + i) * config_interval(cfg);
+			data_curr->next = NULL;
+			if (data_first == NULL)
+				data_first = data_curr;
+			else
+				data_last->next = data_curr;
+			data_last = data_curr;
+			store_point(&st, data_curr);
+		}
+		ring_push_wait(&p->empty, b);
+	}
+	
+	pthread_join(reader, NULL);
+	if (have_decoder)
+		pthread_join(decoder, NULL);
+	
+	/* no half sessions in the archive */
+	if (failed)
+	{
+		store_abort(&st);
+		free_data(data_first);
+		goto abort;
+	}
+	if (0 != store_end(cfg, &st, data_first))
+	{
+		free_data(data_first);
+		goto abort;
+	}
+	result = data_first;
+	
+abort:
+	ring_free(&p->empty);
+	ring_free(&p->filled);
+	ring_free(&p->decoded);
+	free(p);
+	return result;
+}
+
+
+
+void
+print_data(
+	struct data *data_first
+) {
+	struct data *data_curr;
+	char tags[64];
+	data_curr = data_first;
+	
+	if (data_curr == NULL)
+		return;
+	
+	do {
+		
+		if (data_curr->fault)
+			printf("%i %.1f %.1f # %s\n", (int)data_curr->time, data_curr->temp/10.0, data_curr->rh/10.0,
+				fault_tags(data_curr->fault, tags, sizeof(tags)));
+		else
+			printf("%i %.1f %.1f\n", (int)data_curr->time, data_curr->temp/10.0, data_curr->rh/10.0);
+		data_curr = data_curr->next;
+		
+	} while (data_curr != NULL);
+}
+
+
+void
+free_data(
+	struct data *data_first
+) {
+	struct data *data_next;
+	
+	while (data_first != NULL)
+	{
+		data_next = data_first->next;
+		free(data_first);
+		data_first = data_next;
+	}
+}
+
+
+int                                 /* return value: 0 = success */
+follow_data(
+	struct usb_dev_handle *dev_hdl  /* usb dev handle */
+) {
+	struct config *cfg = NULL;
+	struct data *data_first = NULL;
+	struct timespec wakeup;
+	int num_seen;
+	
+	cfg = read_config(dev_hdl);
+	if (cfg == NULL)
+	{
+		printf("follow_data: failed to read config\n");
+		return 1;
+	}
+	
+	/* only print data recorded from now on, like tail -f */
+	num_seen = config_num_data_rec(cfg);
+	
+	clock_gettime(CLOCK_MONOTONIC, &wakeup);
+	
+	while (1)
+	{
+		if (config_num_data_rec(cfg) < num_seen)
+		{
+			/* logger was reconfigured, follow the new log */
+			num_seen = 0;
+		}
+		
+		if (config_num_data_rec(cfg) > num_seen)
+		{
+			/* read only the block(s) holding the new data points */
+			data_first = read_data_from(dev_hdl, cfg, num_seen);
+			if (data_first == NULL)
+			{
+				printf("follow_data: failed to read data\n");
+				free(cfg);
+				return 1;
+			}
+			print_data(data_first);
+			fflush(stdout);
+			if (0 != publish_data(cfg, data_first))
+				printf("follow_data: failed to publish data\n");
+			free_data(data_first); data_first = NULL;
+			num_seen = config_num_data_rec(cfg);
+		}
+		
+		if (config_num_data_rec(cfg) >= config_num_data_conf(cfg))
+		{
+			printf("follow_data: logger is full\n");
+			break;
+		}
+		
+		/* poll once per log interval, on a fixed schedule */
+		/* so the transfer times dont add up */
+		
+		wakeup.tv_sec += config_interval(cfg) > 0 ? config_interval(cfg) : 1;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, NULL) != 0)
+			;
+		
+		free(cfg);
+		cfg = read_config(dev_hdl);
+		if (cfg == NULL)
+		{
+			printf("follow_data: failed to read config\n");
+			return 1;
+		}
+	}
+	
+	free(cfg);
+	return 0;
+}
+
+
+time_t                              /* return value: start time, local (!) timezone */
+config_start_time(
+	struct config *cfg              /* config struct */
+) {
+	struct tm time_start;
+	
+	memset(&time_start, 0, sizeof(time_start));
+	time_start.tm_year = -1900 + config_time_year(cfg);
+	time_start.tm_mon  = -1 + config_time_mon(cfg);
+	time_start.tm_mday = config_time_mday(cfg);
+	time_start.tm_hour = config_time_hour(cfg);
+	time_start.tm_min  = config_time_min(cfg);
+	time_start.tm_sec  = config_time_sec(cfg);
+	
+	/* timegm instead of mktime with TZ=GMT, setenv is not thread safe */
+	return timegm(&time_start);
+}
+
+
+long long                           /* return value: seconds until the logger is full, 0 = full */
+rotate_wait(
+	struct config *cfg              /* config struct */
+) {
+	struct tm now;
+	time_t now_stamp, full_stamp;
+	long long wait;
+	
+	if (config_num_data_rec(cfg) >= config_num_data_conf(cfg) || config_interval(cfg) <= 0)
+		return 0;
+	
+	/* the logger is full with the last configured data point, */
+	/* predict it from the start time, so a late start is no problem */
+	
+	now_stamp = time(NULL);
+	localtime_r(&now_stamp, &now);
+	full_stamp = config_start_time(cfg) + (time_t)(config_num_data_conf(cfg) - 1) * config_interval(cfg);
+	wait = (long long)full_stamp - (now_stamp + now.tm_gmtoff);
+	
+	/* logger not started or clock off: fall back to the count */
+	if (wait <= 0 || config_num_data_rec(cfg) == 0)
+		wait = (long long)(config_num_data_conf(cfg) - config_num_data_rec(cfg)) * config_interval(cfg);
+	
+	return wait;
+}
+
+
+long long                           /* return value: seconds to sleep before checking again */
+rotate_sleep(
+	long long wait,                 /* seconds until the logger is full */
+	int margin                      /* seconds to wake up before */
+) {
+	/* far from the end, wake up a bit early and predict again, */
+	/* the logger clock may drift from ours */
+	if (wait - margin > margin)
+		return (wait - margin) - (wait - margin) / 8;
+	return wait - margin;
+}
+
+
+int                                 /* return value: 0 = success */
+rotate_log(
+	struct usb_dev_handle *dev_hdl, /* usb dev handle */
+	struct config *cfg              /* config struct, as read right before */
+) {
+	struct config cfg_new;
+	struct data *data_first = NULL, *data_last;
+	struct tm now;
+	time_t now_stamp, new_stamp;
+	
+	/* download and store the finished log */
+	
+	if (config_num_data_rec(cfg) > 0 && !catalog_has(cfg))
+	{
+		/* on failure, dont throw away the data on the logger */
+		data_first = read_store_data(dev_hdl, cfg);
+		if (data_first == NULL)
+		{
+			printf("rotate_log: %.16s: failed to read and store data\n", config_name(cfg));
+			return 1;
+		}
+	}
+	
+	/* re-arm right away with the same settings and name */
+	
+	cfg_new = *cfg;
+	config_set_config_begin(&cfg_new, 0xce);
+	config_set_config_end(&cfg_new, 0xce);
+	config_set_num_data_rec(&cfg_new, 0);
+	config_set_start(&cfg_new, 2); /* start automatically, nobody is there to press the button */
+	
+	now_stamp = time(NULL);
+	localtime_r(&now_stamp, &now);
+	config_set_time_year(&cfg_new, now.tm_year + 1900);
+	config_set_time_mon(&cfg_new, now.tm_mon + 1);
+	config_set_time_mday(&cfg_new, now.tm_mday);
+	config_set_time_hour(&cfg_new, now.tm_hour);
+	config_set_time_min(&cfg_new, now.tm_min);
+	config_set_time_sec(&cfg_new, now.tm_sec);
+	new_stamp = now_stamp + now.tm_gmtoff;
+	
+	if (0 != write_config(dev_hdl, &cfg_new))
+	{
+		printf("rotate_log: %.16s: failed to re-arm logger, data is stored\n", config_name(cfg));
+		free_data(data_first);
+		return 1;
+	}
+	
+	/* report the gap between both logs */
+	
+	if (data_first != NULL)
+	{
+		for (data_last = data_first; data_last->next != NULL; data_last = data_last->next)
+			;
+		printf("rotate_log: %.16s: stored %i data points, gap %li sec (%li data points missed)\n",
+			config_name(cfg), config_num_data_rec(cfg), (long)(new_stamp - data_last->time),
+			config_interval(cfg) > 0 ? (long)((new_stamp - data_last->time) / config_interval(cfg)) - 1 : 0L);
+	}
+	else if (config_num_data_rec(cfg) > 0)
+		printf("rotate_log: %.16s: log was stored before\n", config_name(cfg));
+	else
+		printf("rotate_log: %.16s: logger was empty\n", config_name(cfg));
+	fflush(stdout);
+	
+	free_data(data_first);
+	return 0;
+}
+
+
+int                                 /* return value: 0 = success */
+rotate_data(
+	struct usb_dev_handle *dev_hdl, /* usb dev handle */
+	int margin                      /* wake up this many seconds before the logger is full */
+) {
+	struct config *cfg = NULL;
+	struct timespec wakeup;
+	long long wait;
+	
+	if (margin < 0)
+		margin = 0;
+	
+	while (1)
+	{
+		cfg = read_config(dev_hdl);
+		if (cfg == NULL)
+		{
+			printf("rotate_data: failed to read config\n");
+			return 1;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &wakeup);
+		
+		wait = rotate_wait(cfg);
+		if (wait > margin)
+		{
+			/* sleep until shortly before, then check again, */
+			/* the prediction gets better the closer we get */
+			printf("rotate_data: %.16s has %i of %i data points, full in %lli sec\n",
+				config_name(cfg), config_num_data_rec(cfg), config_num_data_conf(cfg), wait);
+			fflush(stdout);
+			wakeup.tv_sec += rotate_sleep(wait, margin);
+			free(cfg); cfg = NULL;
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, NULL) != 0)
+				;
+			continue;
+		}
+		
+		/* within the margin: the data downloaded now is as complete */
+		/* as it gets, waiting for the last data point would lose the */
+		/* data recorded during the download anyway */
+		
+		if (0 != rotate_log(dev_hdl, cfg))
+		{
+			free(cfg);
+			return 1;
+		}
+		free(cfg); cfg = NULL;
+	}
+	
+	return 0;
+}
+
+
+/* fleet scheduler: keep many loggers on several usb busses from running full */
+
+struct fleet_logger {
+	struct usb_device *dev;
+	struct usb_dev_handle *dev_hdl;
+	int ep_in, ep_out;
+	int bus;                        /* index into fleet_active */
+	char name[32];                  /* config name, or bus/device before the first check */
+	long long due;                  /* monotonic time to check the logger next */
+	long long deadline;             /* monotonic time the logger is predicted full */
+	int busy;                       /* bool: a worker has it */
+};
+
+struct fleet {
+	struct fleet_logger *loggers;
+	int num_loggers;
+	int *active;                    /* transfers running per bus */
+	int num_busses;
+	int per_bus;                    /* max transfers per bus */
+	int margin;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+struct fleet_worker {
+	struct fleet *fleet;
+	int home;                       /* bus this worker serves first */
+};
+
+
+long long
+fleet_now(void)
+{
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec;
+}
+
+
+/* pick the due logger with the earliest deadline, on the home bus if possible, */
+/* else steal from another bus with a free slot. call with fleet->lock held. */
+struct fleet_logger *                  /* return value: logger, NULL = nothing due */
+fleet_pick(
+	struct fleet *fleet,
+	int home,                       /* home bus of the worker */
+	long long now,
+	long long *next_due             /* out: earliest due time of the idle loggers */
+) {
+	struct fleet_logger *best = NULL, *stolen = NULL, *l;
+	int i;
+	
+	*next_due = -1;
+	for (i = 0; i < fleet->num_loggers; i++)
+	{
+		l = &fleet->loggers[i];
+		if (l->busy || l->dev_hdl == NULL)
+			continue;
+		if (l->due > now)
+		{
+			if (*next_due < 0 || l->due < *next_due)
+				*next_due = l->due;
+			continue;
+		}
+		if (fleet->active[l->bus] >= fleet->per_bus)
+			continue;
+		if (l->bus == home)
+		{
+			if (best == NULL || l->deadline < best->deadline)
+				best = l;
+		}
+		else if (stolen == NULL || l->deadline < stolen->deadline)
+			stolen = l;
+	}
+	return best != NULL ? best : stolen;
+}
+
+
+void *
+fleet_work(
+	void *arg                       /* struct fleet_worker */
+) {
+	struct fleet_worker *worker = arg;
+	struct fleet *fleet = worker->fleet;
+	struct fleet_logger *l;
+	struct config *cfg;
+	struct timespec until;
+	long long now, next_due, wait;
+	int ret;
+	
+	pthread_mutex_lock(&fleet->lock);
+	while (1)
+	{
+		now = fleet_now();
+		l = fleet_pick(fleet, worker->home, now, &next_due);
+		if (l == NULL)
+		{
+			if (next_due < 0)
+			{
+				/* all loggers taken or gone */
+				pthread_cond_wait(&fleet->cond, &fleet->lock);
+				continue;
+			}
+			clock_gettime(CLOCK_MONOTONIC, &until);
+			until.tv_sec += next_due - now;
+			pthread_cond_timedwait(&fleet->cond, &fleet->lock, &until);
+			continue;
+		}
+		l->busy = 1;
+		fleet->active[l->bus]++;
+		pthread_mutex_unlock(&fleet->lock);
+		
+		/* endpoints are per thread, the logger may move between workers */
+		EP_IN = l->ep_in;
+		EP_OUT = l->ep_out;
+		
+		ret = 1;
+		wait = 0;
+		cfg = read_config(l->dev_hdl);
+		if (cfg != NULL)
+		{
+			snprintf(l->name, sizeof(l->name), "%.16s", config_name(cfg));
+			wait = rotate_wait(cfg);
+			ret = 0;
+			if (wait <= fleet->margin)
+			{
+				ret = rotate_log(l->dev_hdl, cfg);
+				wait = (long long)config_num_data_conf(cfg) * (config_interval(cfg) > 0 ? config_interval(cfg) : 1);
+			}
+			free(cfg);
+		}
+		
+		pthread_mutex_lock(&fleet->lock);
+		now = fleet_now();
+		if (ret != 0)
+		{
+			/* try again later, the other loggers go on */
+			printf("fleet_data: %s failed, retry in %i sec\n", l->name, fleet->margin > 0 ? fleet->margin : 1);
+			l->due = now + (fleet->margin > 0 ? fleet->margin : 1);
+		}
+		else
+		{
+			l->deadline = now + wait;
+			l->due = now + (wait > fleet->margin ? rotate_sleep(wait, fleet->margin) : 0);
+		}
+		l->busy = 0;
+		fleet->active[l->bus]--;
+		pthread_cond_broadcast(&fleet->cond);
+	}
+	pthread_mutex_unlock(&fleet->lock);
+	
+	return NULL;
+}
+
+
+int                    /* return value: 0 = success */
+fleet_data(
+	int per_bus,       /* max transfers per usb bus */
+	int margin         /* rotate this many seconds before a logger is full */
+) {
+	struct fleet fleet;
+	struct fleet_worker *workers;
+	pthread_condattr_t cond_attr;
+	pthread_t *threads;
+	struct usb_bus *bus_cur;
+	struct usb_device *dev_cur;
+	int num_workers, num_threads = 0, bus, i, n, num;
+	
+	if (transcript_in != NULL || transcript_out != NULL)
+	{
+		printf("fleet_data: -R and -P work with a single logger only\n");
+		return 1;
+	}
+	
+	memset(&fleet, 0, sizeof(fleet));
+	fleet.per_bus = per_bus > 0 ? per_bus : 1;
+	fleet.margin = margin > 0 ? margin : 0;
+	
+	usb_init();
+	if (usb_find_busses() < 0 || usb_find_devices() < 0)
+	{
+		printf("fleet_data: failed to find usb devices\n");
+		return 1;
+	}
+	
+	/* collect all loggers, grouped by bus */
+	
+	for (bus_cur = usb_get_busses(); bus_cur != NULL; bus_cur = bus_cur->next)
+	{
+		n = 0;
+		for (dev_cur = bus_cur->devices; dev_cur != NULL; dev_cur = dev_cur->next)
+		{
+			if (dev_cur->descriptor.idVendor != VID ||
+				(dev_cur->descriptor.idProduct != PID && dev_cur->descriptor.idProduct != PID2))
+				continue;
+			fleet.loggers = realloc(fleet.loggers, (fleet.num_loggers + 1) * sizeof(struct fleet_logger));
+			memset(&fleet.loggers[fleet.num_loggers], 0, sizeof(struct fleet_logger));
+			fleet.loggers[fleet.num_loggers].dev = dev_cur;
+			fleet.loggers[fleet.num_loggers].bus = fleet.num_busses;
+			snprintf(fleet.loggers[fleet.num_loggers].name, 32, "%.15s/%.15s", bus_cur->dirname, dev_cur->filename);
+			fleet.num_loggers++;
+			n++;
+		}
+		if (n > 0)
+			fleet.num_busses++;
+	}
+	if (fleet.num_loggers == 0)
+	{
+		printf("device %04x:%04x not found\n", VID, PID);
+		return 1;
+	}
+	
+	/* open all loggers, they are checked right away */
+	
+	for (i = 0; i < fleet.num_loggers; i++)
+	{
+		fleet.loggers[i].dev_hdl = open_logger(fleet.loggers[i].dev);
+		fleet.loggers[i].ep_in = EP_IN;
+		fleet.loggers[i].ep_out = EP_OUT;
+		if (fleet.loggers[i].dev_hdl == NULL)
+			printf("fleet_data: skipping logger %s\n", fleet.loggers[i].name);
+	}
+	printf("fleet_data: %i loggers on %i busses\n", fleet.num_loggers, fleet.num_busses);
+	fflush(stdout);
+	
+	/* one worker per cpu, but not more than transfers can run at once; */
+	/* workers are spread over the busses and steal from busier ones */
+	
+	num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	fleet.active = calloc(fleet.num_busses, sizeof(int));
+	for (n = 0, bus = 0; bus < fleet.num_busses; bus++)
+	{
+		for (i = 0, num = 0; i < fleet.num_loggers; i++)
+			if (fleet.loggers[i].bus == bus)
+				num++;
+		n += num < fleet.per_bus ? num : fleet.per_bus;
+	}
+	if (num_workers > n)
+		num_workers = n;
+	if (num_workers < 1)
+		num_workers = 1;
+	
+	/* the workers wait for deadlines on the monotonic clock */
+	pthread_mutex_init(&fleet.lock, NULL);
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&fleet.cond, &cond_attr);
+	pthread_condattr_destroy(&cond_attr);
+	workers = calloc(num_workers, sizeof(struct fleet_worker));
+	threads = calloc(num_workers, sizeof(pthread_t));
+	for (i = 0; i < num_workers; i++)
+	{
+		workers[i].fleet = &fleet;
+		workers[i].home = i % fleet.num_busses;
+		if (0 != pthread_create(&threads[i], NULL, fleet_work, &workers[i]))
+		{
+			printf("fleet_data: failed to start worker %i\n", i);
+			break;
+		}
+		num_threads++;
+	}
+	
+	/* the workers run until the program is stopped */
+	for (i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+	
+	for (i = 0; i < fleet.num_loggers; i++)
+		if (fleet.loggers[i].dev_hdl != NULL)
+			usb_close(fleet.loggers[i].dev_hdl);
+	free(fleet.loggers);
+	free(fleet.active);
+	free(workers);
+	free(threads);
+	return num_threads > 0 ? 0 : 1;
+}
+
+
+/* hotplug mode: download each logger as soon as it is plugged in */
+
+pthread_mutex_t hotplug_usb_lock = PTHREAD_MUTEX_INITIALIZER; /* the libusb-0.1 device list is not thread safe */
+
+struct hotplug_job {
+	char busnum[16];                /* as in /dev/bus/usb/BUSNUM/DEVNUM */
+	char devnum[16];
+	int rearm;                      /* bool: start a new log after the download */
+	struct timespec plugged;        /* when the uevent came in */
+};
+
+
+void *
+hotplug_work(
+	void *arg                       /* struct hotplug_job, freed here */
+) {
+	struct hotplug_job *job = arg;
+	struct usb_bus *bus_cur;
+	struct usb_device *dev_cur;
+	struct usb_dev_handle *dev_hdl = NULL;
+	struct config *cfg = NULL;
+	struct data *data_first = NULL;
+	struct timespec ts = {0, 100000000}, done;
+	int try, found = 0, ret = 1;
+	
+	/* the device node may show up a bit after the uevent */
+	for (try = 0; try < 20 && dev_hdl == NULL; try++)
+	{
+		if (try > 0)
+			nanosleep(&ts, NULL);
+		pthread_mutex_lock(&hotplug_usb_lock);
+		usb_find_busses();
+		usb_find_devices();
+		for (bus_cur = usb_get_busses(); bus_cur != NULL && dev_hdl == NULL; bus_cur = bus_cur->next)
+		{
+			if (0 != strcmp(bus_cur->dirname, job->busnum))
+				continue;
+			for (dev_cur = bus_cur->devices; dev_cur != NULL; dev_cur = dev_cur->next)
+			{
+				if (0 != strcmp(dev_cur->filename, job->devnum))
+					continue;
+				found = 1;
+				dev_hdl = open_logger(dev_cur);
+				break;
+			}
+		}
+		pthread_mutex_unlock(&hotplug_usb_lock);
+		
+		/* the device was there but could not be opened */
+		if (found && dev_hdl == NULL)
+			break;
+	}
+	if (dev_hdl == NULL)
+	{
+		printf("hotplug_data: %s/%s: failed to open logger\n", job->busnum, job->devnum);
+		free(job);
+		return NULL;
+	}
+	
+	cfg = read_config(dev_hdl);
+	if (cfg == NULL)
+		printf("hotplug_data: %s/%s: failed to read config\n", job->busnum, job->devnum);
+	else if (job->rearm)
+		ret = rotate_log(dev_hdl, cfg);
+	else if (config_num_data_rec(cfg) == 0)
+	{
+		printf("hotplug_data: %.16s: logger is empty\n", config_name(cfg));
+		ret = 0;
+	}
+	else if (catalog_has(cfg))
+	{
+		printf("hotplug_data: %.16s: log was stored before\n", config_name(cfg));
+		ret = 0;
+	}
+	else
+	{
+		data_first = read_store_data(dev_hdl, cfg);
+		if (data_first != NULL)
+			ret = 0;
+	}
+	
+	if (ret == 0)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &done);
+		printf("hotplug_data: %.16s done, %.3f sec after plug-in\n", config_name(cfg),
+			(done.tv_sec - job->plugged.tv_sec) + (done.tv_nsec - job->plugged.tv_nsec) / 1e9);
+	}
+	else
+		printf("hotplug_data: %s/%s: failed, logger is left as it is\n", job->busnum, job->devnum);
+	fflush(stdout);
+	
+	free_data(data_first);
+	free(cfg);
+	usb_close(dev_hdl);
+	free(job);
+	return NULL;
+}
+
+
+int                    /* return value: 0 = success */
+hotplug_data(
+	int rearm          /* bool: start a new log after the download */
+) {
+	struct sockaddr_nl addr;
+	struct iovec iov;
+	struct msghdr msg;
+	struct hotplug_job *job;
+	pthread_attr_t attr;
+	pthread_t thread;
+	char buf[4096], *action, *devtype, *product, *busnum, *devnum, *pos;
+	unsigned int vid, pid;
+	int fd, len;
+	
+	if (transcript_in != NULL || transcript_out != NULL)
+	{
+		printf("hotplug_data: -R and -P work with a single logger only\n");
+		return 1;
+	}
+	
+	/* listen to the kernel uevents, as udev does */
+	
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+	{
+		printf("hotplug_data: failed to open netlink socket: %s\n", strerror(errno));
+		return 1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = 1; /* kernel events */
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		printf("hotplug_data: failed to bind netlink socket: %s\n", strerror(errno));
+		close(fd);
+		return 1;
+	}
+	
+	pthread_mutex_lock(&hotplug_usb_lock);
+	usb_init();
+	pthread_mutex_unlock(&hotplug_usb_lock);
+	
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	
+	printf("hotplug_data: waiting for loggers %04x:%04x, %04x:%04x\n", VID, PID, VID, PID2);
+	fflush(stdout);
+	
+	while (1)
+	{
+		memset(&msg, 0, sizeof(msg));
+		iov.iov_base = buf;
+		iov.iov_len = sizeof(buf) - 1;
+		msg.msg_name = &addr;
+		msg.msg_namelen = sizeof(addr);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		
+		len = recvmsg(fd, &msg, 0);
+		if (len < 0)
+		{
+			if (errno == EINTR || errno == ENOBUFS)
+				continue;
+			printf("hotplug_data: failed to receive uevent: %s\n", strerror(errno));
+			break;
+		}
+		
+		/* only trust the kernel */
+		if (addr.nl_pid != 0)
+			continue;
+		
+		/* "add@/devices/...\0ACTION=add\0SUBSYSTEM=usb\0..." */
+		buf[len] = 0;
+		action = devtype = product = busnum = devnum = NULL;
+		for (pos = buf; pos < buf + len; pos += strlen(pos) + 1)
+		{
+			if (0 == strncmp(pos, "ACTION=", 7))
+				action = pos + 7;
+			else if (0 == strncmp(pos, "DEVTYPE=", 8))
+				devtype = pos + 8;
+			else if (0 == strncmp(pos, "PRODUCT=", 8))
+				product = pos + 8;
+			else if (0 == strncmp(pos, "BUSNUM=", 7))
+				busnum = pos + 7;
+			else if (0 == strncmp(pos, "DEVNUM=", 7))
+				devnum = pos + 7;
+		}
+		if (action == NULL || devtype == NULL || product == NULL || busnum == NULL || devnum == NULL)
+			continue;
+		if (0 != strcmp(action, "add") || 0 != strcmp(devtype, "usb_device"))
+			continue;
+		
+		/* PRODUCT=10c4/ea61/100, hex without leading zeros */
+		if (2 != sscanf(product, "%x/%x", &vid, &pid) || vid != VID || (pid != PID && pid != PID2))
+			continue;
+		
+		/* one worker per logger, so plug-ins dont wait for each other */
+		job = calloc(1, sizeof(struct hotplug_job));
+		if (job == NULL)
+			continue;
+		snprintf(job->busnum, sizeof(job->busnum), "%s", busnum);
+		snprintf(job->devnum, sizeof(job->devnum), "%s", devnum);
+		job->rearm = rearm;
+		clock_gettime(CLOCK_MONOTONIC, &job->plugged);
+		printf("hotplug_data: logger plugged in at %s/%s\n", job->busnum, job->devnum);
+		fflush(stdout);
+		if (0 != pthread_create(&thread, &attr, hotplug_work, job))
+		{
+			printf("hotplug_data: failed to start worker\n");
+			free(job);
+		}
+	}
+	
+	pthread_attr_destroy(&attr);
+	close(fd);
+	return 1;
+}
+
+
+/*
+*  watch mode: every logger gets a thread that polls it right after its
+*  next data point is due, reads only the new data points and checks
+*  them for alarms, see alarm.c. so an alarm is reported within about a
+*  second of the data point being recorded, not at the next download.
+*/
+
+#define WATCH_SLACK 1 /* seconds to poll after a data point is due */
+
+struct watch_logger {
+	struct usb_dev_handle *dev_hdl;
+	int ep_in, ep_out;
+	char location[32];              /* "usb:BUS/DEVICE" */
+};
+
+long long                           /* return value: seconds to sleep before the next poll */
+watch_wait(
+	struct config *cfg              /* config struct */
+) {
+	struct tm now;
+	time_t now_stamp, next_stamp;
+	long long interval, wait;
+	
+	interval = config_interval(cfg) > 0 ? config_interval(cfg) : 1;
+	if (config_num_data_rec(cfg) == 0)
+		return interval;
+	
+	/* data point n is due at start + n * interval, as in rotate_wait */
+	
+	now_stamp = time(NULL);
+	localtime_r(&now_stamp, &now);
+	next_stamp = config_start_time(cfg) + (time_t)config_num_data_rec(cfg) * interval;
+	wait = (long long)next_stamp - (now_stamp + now.tm_gmtoff) + WATCH_SLACK;
+	
+	/* a bit late: ask again each second, clock off: once per interval */
+	if (wait <= -interval)
+		wait = interval;
+	else if (wait < 1)
+		wait = 1;
+	if (wait > interval)
+		wait = interval;
+	return wait;
+}
+
+void *
+watch_work(
+	void *arg                       /* struct watch_logger */
+) {
+	struct watch_logger *w = arg;
+	struct config *cfg, *cfg_new;
+	struct data *data_first;
+	struct alarm alarm;
+	struct timespec pause;
+	double wait, pending;
+	int num_seen;
+	
+	EP_IN = w->ep_in;
+	EP_OUT = w->ep_out;
+	snprintf(logger_location, sizeof(logger_location), "%s", w->location);
+	alarm_init(&alarm);
+	
+	cfg = read_config(w->dev_hdl);
+	if (cfg == NULL)
+	{
+		printf("watch_data: %s: failed to read config\n", w->location);
+		return NULL;
+	}
+	live_poll(cfg);
+	printf("watch_data: %.16s: temp %i .. %i, rh %i .. %i, every %i sec\n", config_name(cfg),
+		config_thresh_temp_low(cfg), config_thresh_temp_high(cfg),
+		config_thresh_rh_low(cfg), config_thresh_rh_high(cfg), config_interval(cfg));
+	fflush(stdout);
+	
+	/* the newest data point gives the state to start with */
+	num_seen = config_num_data_rec(cfg) > 0 ? config_num_data_rec(cfg) - 1 : 0;
+	
+	while (1)
+	{
+		if (config_num_data_rec(cfg) < num_seen)
+		{
+			/* logger was reconfigured, watch the new log */
+			num_seen = 0;
+		}
+	
+		data_first = NULL;
+		if (config_num_data_rec(cfg) > num_seen)
+		{
+			data_first = read_data_from(w->dev_hdl, cfg, num_seen);
+			if (data_first == NULL)
+			{
+				printf("watch_data: %.16s: failed to read data\n", config_name(cfg));
+				live_fail(cfg);
+				break;
+			}
+			num_seen = config_num_data_rec(cfg);
+		}
+	
+		/* alarms first, the rest can wait */
+		alarm_check(&alarm, cfg, data_first);
+		if (data_first != NULL && 0 != publish_data(cfg, data_first))
+			printf("watch_data: %.16s: failed to publish data\n", config_name(cfg));
+		free_data(data_first);
+	
+		pending = alarm_pending(&alarm);
+		if (config_num_data_rec(cfg) >= config_num_data_conf(cfg) && pending < 0)
+		{
+			printf("watch_data: %.16s: logger is full\n", config_name(cfg));
+			break;
+		}
+	
+		wait = watch_wait(cfg);
+		if (pending >= 0 && pending < wait)
+			wait = pending;
+		pause.tv_sec = wait;
+		pause.tv_nsec = (wait - pause.tv_sec) * 1e9;
+		while (clock_nanosleep(CLOCK_MONOTONIC, 0, &pause, &pause) != 0)
+			;
+	
+		cfg_new = read_config(w->dev_hdl);
+		if (cfg_new == NULL)
+		{
+			printf("watch_data: %.16s: failed to read config\n", config_name(cfg));
+			live_fail(cfg);
+			break;
+		}
+		free(cfg);
+		cfg = cfg_new;
+		live_poll(cfg);
+	}
+	
+	free(cfg);
+	return NULL;
+}
+
+int                    /* return value: 0 = success */
+watch_data(
+	char *hook,        /* fifo or shell command */
+	double hysteresis, /* in °C, °F or % */
+	int holdoff        /* min seconds between hooks per logger and quantity */
+) {
+	struct watch_logger *loggers = NULL;
+	pthread_t *threads;
+	struct usb_bus *bus_cur;
+	struct usb_device *dev_cur;
+	struct usb_dev_handle *dev_hdl;
+	int num_loggers = 0, num_threads = 0, i;
+	
+	if (transcript_in != NULL || transcript_out != NULL)
+	{
+		printf("watch_data: -R and -P work with a single logger only\n");
+		return 1;
+	}
+	
+	alarm_hook = 0 == strcmp(hook, "-") ? NULL : hook;
+	alarm_hysteresis = hysteresis * 10 + 0.5;
+	alarm_holdoff = holdoff > 0 ? holdoff : 0;
+	
+	usb_init();
+	if (usb_find_busses() < 0 || usb_find_devices() < 0)
+	{
+		printf("watch_data: failed to find usb devices\n");
+		return 1;
+	}
+	
+	for (bus_cur = usb_get_busses(); bus_cur != NULL; bus_cur = bus_cur->next)
+	{
+		for (dev_cur = bus_cur->devices; dev_cur != NULL; dev_cur = dev_cur->next)
+		{
+			if (dev_cur->descriptor.idVendor != VID ||
+				(dev_cur->descriptor.idProduct != PID && dev_cur->descriptor.idProduct != PID2))
+				continue;
+			dev_hdl = open_logger(dev_cur);
+			if (dev_hdl == NULL)
+			{
+				printf("watch_data: skipping logger %.15s/%.15s\n", bus_cur->dirname, dev_cur->filename);
+				continue;
+			}
+			loggers = realloc(loggers, (num_loggers + 1) * sizeof(struct watch_logger));
+			loggers[num_loggers].dev_hdl = dev_hdl;
+			loggers[num_loggers].ep_in = EP_IN;
+			loggers[num_loggers].ep_out = EP_OUT;
+			snprintf(loggers[num_loggers].location, 32, "%s", logger_location);
+			num_loggers++;
+		}
+	}
+	if (num_loggers == 0)
+	{
+		printf("device %04x:%04x not found\n", VID, PID);
+		return 1;
+	}
+	
+	threads = calloc(num_loggers, sizeof(pthread_t));
+	for (i = 0; i < num_loggers; i++)
+	{
+		if (0 != pthread_create(&threads[num_threads], NULL, watch_work, &loggers[i]))
+		{
+			printf("watch_data: failed to start watcher for %s\n", loggers[i].location);
+			continue;
+		}
+		num_threads++;
+	}
+	
+	/* until every logger is full or gone */
+	for (i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+	
+	for (i = 0; i < num_loggers; i++)
+		usb_close(loggers[i].dev_hdl);
+	free(threads);
+	free(loggers);
+	return 0;
+}
+
+
+/* hand new data to the live consumers: -I, -M */
+int                    /* return value: 0 = success */
+publish_data(
+	struct config *cfg,
+	struct data *data_first /* new data of this logger */
+) {
+	int ret = 0;
+	
+	ret |= influx_add(cfg, data_first);
+	ret |= stats_add(cfg, data_first);
+	live_add(cfg, data_first);
+	return ret;
+}
+
+
+int                    /* return value: 0 = success */
+store_data(
+	struct config *cfg,
+	struct data *data_first
+) {
+	struct data *data_curr;
+	struct store st;
+	
+	if (data_first == NULL)
+		return 0;
+	
+	if (0 != store_begin(cfg, &st))
+		return 1;
+	for (data_curr = data_first; data_curr != NULL; data_curr = data_curr->next)
+		store_point(&st, data_curr);
+	return store_end(cfg, &st, data_first);
+}
+
+
+int                    /* return value: 0 = success */
+store_begin(
+	struct config *cfg,
+	struct store *st   /* gets LOGNAME.dat, opened with the session header written */
+) {
+	char line[128], hist_path[1024];
+	long long archive_last, hist_last;
+	int len, removed, cut;
+	
+	memset(st, 0, sizeof(*st));
+	snprintf(st->path, sizeof(st->path), "%.16s.dat", config_name(cfg));
+	fault_init(&st->fault, config_temp_is_fahrenheit(cfg));
+	
+	/* a session torn by a crash must not stay in front of this one */
+	snprintf(hist_path, sizeof(hist_path), "%.16s.hist", config_name(cfg));
+	if (0 != archive_recover(st->path, &removed, &archive_last) ||
+		0 != hist_recover(hist_path, &cut, &hist_last))
+	{
+		printf("store_data: failed to check %s\n", st->path);
+		return 1;
+	}
+	
+	/* the sketches may hold part of what was removed, or miss it; a crash */
+	/* before the sync of the last session may have kept it in one file only */
+	if (!removed && !cut && archive_last >= 0 && archive_last != hist_last)
+	{
+		printf("store_data: %s does not end with the last session of %s\n", hist_path, st->path);
+		cut = 1;
+	}
+	if ((removed || cut) && 0 != sketch_archive(st->path, config_temp_is_fahrenheit(cfg)))
+		return 1;
+	
+	st->file = fopen(st->path, "a");
+	if (st->file == NULL)
+	{
+		printf("store_data: failed to fopen(\"%s\", \"a+\")\n", st->path);
+		return 1;
+	}
+	fseek(st->file, 0, SEEK_END);
+	st->offset = ftell(st->file);
+	printf("writing log data to %s\n", st->path);
+	
+	len = snprintf(line, sizeof(line), "# [%04i-%02i-%02i %02i:%02i:%02i] %i points @ %i sec\n",
+		config_time_year(cfg),
+		config_time_mon(cfg),
+		config_time_mday(cfg),
+		config_time_hour(cfg),
+		config_time_min(cfg),
+		config_time_sec(cfg),
+		config_num_data_rec(cfg),
+		config_interval(cfg)
+	);
+	archive_put(st, line, len);
+	return 0;
+}
+
+
+void
+store_point(
+	struct store *st,  /* as set up by store_begin */
+	struct data *data_curr /* kept until the next call, NULL = write the last one */
+) {
+	struct data *data_prev = st->pending;
+	char line[192], tags[64];
+	int len;
+	
+	/* the data point before is final once this one is checked */
+	if (data_curr != NULL)
+		fault_add(&st->fault, data_curr);
+	else
+		fault_end(&st->fault);
+	st->pending = data_curr;
+	if (data_prev == NULL)
+		return;
+	
+	if (calib_keep_raw)
+		len = snprintf(line, sizeof(line), "%i %.1f %.1f %.1f %.1f", (int)data_prev->time, data_prev->temp/10.0, data_prev->rh/10.0,
+			data_prev->temp_raw/10.0, data_prev->rh_raw/10.0);
+	else
+		len = snprintf(line, sizeof(line), "%i %.1f %.1f", (int)data_prev->time, data_prev->temp/10.0, data_prev->rh/10.0);
+	if (data_prev->fault)
+		len += snprintf(line + len, sizeof(line) - len, " # %s", fault_tags(data_prev->fault, tags, sizeof(tags)));
+	len += snprintf(line + len, sizeof(line) - len, "\n");
+	archive_put(st, line, len);
+	st->num_data++;
+}
+
+
+int                    /* return value: 0 = success */
+store_end(
+	struct config *cfg,
+	struct store *st,  /* as set up by store_begin, closed */
+	struct data *data_first /* the data stored */
+) {
+	char hist_path[1024], summary[128];
+	FILE *histfile = NULL;
+	int fds[3], num_fds = 0, dir = -1, ret = 1;
+	
+	store_point(st, NULL);
+	if (fault_summary(&st->fault, summary, sizeof(summary)) > 0)
+		printf("%.16s: %s\n", config_name(cfg), summary);
+	
+	/* the trailer tells a complete session from a torn one, see archive.c */
+	if (0 != archive_trailer(st) || 0 != fflush(st->file))
+	{
+		printf("store_data: failed to write %s\n", st->path);
+		goto done;
+	}
+	
+	/* histogram sketch of the session, see hist.c */
+	snprintf(hist_path, sizeof(hist_path), "%.16s.hist", config_name(cfg));
+	histfile = fopen(hist_path, "a");
+	if (histfile == NULL)
+	{
+		printf("store_data: failed to fopen(\"%s\", \"a\")\n", hist_path);
+		goto done;
+	}
+	if (0 != hist_write(histfile, data_first, config_interval(cfg), config_temp_is_fahrenheit(cfg)) ||
+		0 != fflush(histfile))
+	{
+		printf("store_data: failed to write %s\n", hist_path);
+		goto done;
+	}
+	
+	/* on disk with one sync, shared with the downloads finishing now; */
+	/* a new archive needs its directory entry, too */
+	fds[num_fds++] = fileno(st->file);
+	fds[num_fds++] = fileno(histfile);
+	if (st->offset == 0)
+	{
+		dir = open(".", O_RDONLY);
+		if (dir >= 0)
+			fds[num_fds++] = dir;
+	}
+	if (0 != archive_commit(fds, num_fds))
+	{
+		printf("store_data: failed to sync %s\n", st->path);
+		goto done;
+	}
+	ret = 0;
+	
+	/* a failure here only costs a download next time */
+	catalog_add(cfg, st->num_data);
+	
+done:
+	if (dir >= 0)
+		close(dir);
+	if (histfile != NULL && 0 != fclose(histfile))
+		ret = 1;
+	if (0 != fclose(st->file))
+		ret = 1;
+	st->file = NULL;
+	if (ret != 0)
+		return 1;
+	
+	/* the data is stored, a consumer failing is no reason to keep it on the logger */
+	if (0 != publish_data(cfg, data_first))
+		printf("store_data: %.16s: failed to publish data\n", config_name(cfg));
+	return 0;
+}
+
+
+void
+store_abort(
+	struct store *st   /* as set up by store_begin, closed, the session removed */
+) {
+	fflush(st->file);
+	if (0 != ftruncate(fileno(st->file), st->offset))
+		printf("store_data: failed to remove the incomplete session from %s\n", st->path);
+	fclose(st->file);
+	st->file = NULL;
+}
+
+
+struct data *          /* return value: first data struct, NULL = end of file */
+load_data(
+	FILE *dumpfile,    /* file written by store_data */
+	struct config *cfg /* config struct, gets start time, number of data and interval */
+) {
+	struct data *data_first = NULL;
+	struct data *data_last  = NULL;
+	struct data *data_curr  = NULL;
+	char line[256];
+	char *pos, *end;
+	double temp, rh, temp_raw, rh_raw;
+	long stamp;
+	int c, num_data = 0;
+	int year, mon, mday, hour, min, sec, points, interval;
+	
+	config_set_num_data_rec(cfg, 0);
+	
+	while ((c = getc(dumpfile)) != EOF)
+	{
+		ungetc(c, dumpfile);
+		
+		/* stop in front of the next session */
+		if (c == '#' && num_data > 0)
+			break;
+		
+		if (fgets(line, sizeof(line), dumpfile) == NULL)
+			break;
+		
+		/* session header, see store_data */
+		if (line[0] == '#')
+		{
+			if (8 == sscanf(line, "# [%d-%d-%d %d:%d:%d] %d points @ %d sec",
+				&year, &mon, &mday, &hour, &min, &sec,
+				&points, &interval))
+			{
+				config_set_num_data_conf(cfg, points);
+				config_set_interval(cfg, interval);
+				config_set_time_year(cfg, year);
+				config_set_time_mon(cfg, mon);
+				config_set_time_mday(cfg, mday);
+				config_set_time_hour(cfg, hour);
+				config_set_time_min(cfg, min);
+				config_set_time_sec(cfg, sec);
+			}
+			continue;
+		}
+		
+		stamp = strtol(line, &pos, 10);
+		if (pos == line)
+			continue;
+		temp = strtod(pos, &pos);
+		rh = strtod(pos, &pos);
+		
+		/* raw values, if stored with -K */
+		temp_raw = strtod(pos, &end);
+		if (end == pos)
+			temp_raw = temp;
+		rh_raw = strtod(end, &pos);
+		if (end == pos)
+			rh_raw = rh;
+		
+		data_curr = malloc(sizeof(struct data));
+		data_curr->time = stamp;
+		data_curr->temp = temp < 0 ? temp * 10 - 0.5 : temp * 10 + 0.5;
+		data_curr->rh   = rh < 0 ? rh * 10 - 0.5 : rh * 10 + 0.5;
+		data_curr->temp_raw = temp_raw < 0 ? temp_raw * 10 - 0.5 : temp_raw * 10 + 0.5;
+		data_curr->rh_raw   = rh_raw < 0 ? rh_raw * 10 - 0.5 : rh_raw * 10 + 0.5;
+		data_curr->fault = 0;
+		data_curr->next = NULL;
+		
+		if (num_data == 0)
+			data_first = data_curr;
+		else
+			data_last->next = data_curr;
+		data_last = data_curr;
+		num_data++;
+	}
+	
+	config_set_num_data_rec(cfg, num_data);
+	return data_first;
+}
+
+
+int                    /* return value: 0 = success */
+store_arrow(
+	struct config *cfg,
+	struct data *data_first,
+	char *path
+) {
+	struct arrow_file af;
+	struct data *data_curr;
+	long long *time;
+	float *temp, *rh;
+	int num_data, i, ret;
+	char start[32], num_conf[16], num_rec[16], interval[16];
+	char temp_low[16], temp_high[16], rh_low[16], rh_high[16], name[17];
+	
+	snprintf(name, sizeof(name), "%.16s", config_name(cfg));
+	sprintf(start, "%04i-%02i-%02i %02i:%02i:%02i",
+		config_time_year(cfg), config_time_mon(cfg), config_time_mday(cfg),
+		config_time_hour(cfg), config_time_min(cfg), config_time_sec(cfg));
+	sprintf(num_conf, "%i", config_num_data_conf(cfg));
+	sprintf(num_rec, "%i", config_num_data_rec(cfg));
+	sprintf(interval, "%i", config_interval(cfg));
+	sprintf(temp_low, "%i", config_thresh_temp_low(cfg));
+	sprintf(temp_high, "%i", config_thresh_temp_high(cfg));
+	sprintf(rh_low, "%i", config_thresh_rh_low(cfg));
+	sprintf(rh_high, "%i", config_thresh_rh_high(cfg));
+	
+	char *meta[] = {
+		"name", name,
+		"start", start,
+		"num_data_conf", num_conf,
+		"num_data_rec", num_rec,
+		"interval", interval,
+		"temp_unit", config_temp_is_fahrenheit(cfg) ? "°F" : "°C",
+		"rh_unit", "%",
+		"thresh_temp_low", temp_low,
+		"thresh_temp_high", temp_high,
+		"thresh_rh_low", rh_low,
+		"thresh_rh_high", rh_high,
+	};
+	
+	num_data = 0;
+	for (data_curr = data_first; data_curr != NULL; data_curr = data_curr->next)
+		num_data++;
+	
+	time = malloc(sizeof(long long) * (num_data + 1));
+	temp = malloc(sizeof(float) * (num_data + 1));
+	rh   = malloc(sizeof(float) * (num_data + 1));
+	
+	i = 0;
+	for (data_curr = data_first; data_curr != NULL; data_curr = data_curr->next)
+	{
+		time[i] = data_curr->time;
+		temp[i] = data_curr->temp/10.0;
+		rh[i]   = data_curr->rh/10.0;
+		i++;
+	}
+	
+	printf("writing log data to %s\n", path);
+	ret = arrow_open(&af, path, sizeof(meta) / sizeof(meta[0]) / 2, meta);
+	if (ret == 0)
+	{
+		ret = arrow_write_batch(&af, num_data, time, temp, rh, 0, NULL);
+		if (0 != arrow_close(&af))
+			ret = 1;
+		
+		/* no file that looks complete but is not */
+		if (ret != 0)
+			unlink(path);
+	}
+	
+	free(time);
+	free(temp);
+	free(rh);
+	return ret;
+}
+
+
+int                    /* return value: 0 = success */
+convert_arrow(
+	char *dumpfile_path /* file written by store_data */
+) {
+	struct arrow_file af;
+	struct config cfg;
+	struct data *data_first, *data_curr;
+	FILE *dumpfile;
+	char path[1024], name[17], *ext;
+	char start[32], num_rec[16], interval[16];
+	long long *time = NULL;
+	float *temp = NULL, *rh = NULL;
+	int size = 0, num_data, ret = 0;
+	
+	dumpfile = fopen(dumpfile_path, "r");
+	if (dumpfile == NULL)
+	{
+		printf("convert_arrow: failed to fopen(\"%s\", \"r\")\n", dumpfile_path);
+		return 1;
+	}
+	
+	/* LOGNAME.dat --> LOGNAME.arrow */
+	snprintf(path, sizeof(path) - 6, "%s", dumpfile_path);
+	ext = strrchr(path, '.');
+	if (ext != NULL && 0 == strcmp(ext, ".dat"))
+		*ext = 0;
+	snprintf(name, sizeof(name), "%.16s", strrchr(path, '/') ? strrchr(path, '/') + 1 : path);
+	strcat(path, ".arrow");
+	
+	char *file_meta[] = {
+		"name", name,
+		"source", dumpfile_path,
+	};
+	char *batch_meta[] = {
+		"start", start,
+		"num_data_rec", num_rec,
+		"interval", interval,
+	};
+	
+	printf("writing log data to %s\n", path);
+	if (0 != arrow_open(&af, path, 2, file_meta))
+	{
+		fclose(dumpfile);
+		return 1;
+	}
+	
+	/* one record batch per session, so memory stays bounded by the session size */
+	memset(&cfg, 0, sizeof(cfg));
+	while ((data_first = load_data(dumpfile, &cfg)) != NULL)
+	{
+		if (size < config_num_data_rec(&cfg))
+		{
+			size = config_num_data_rec(&cfg);
+			time = realloc(time, sizeof(long long) * size);
+			temp = realloc(temp, sizeof(float) * size);
+			rh   = realloc(rh, sizeof(float) * size);
+		}
+		
+		num_data = 0;
+		for (data_curr = data_first; data_curr != NULL; data_curr = data_curr->next)
+		{
+			time[num_data] = data_curr->time;
+			temp[num_data] = data_curr->temp/10.0;
+			rh[num_data]   = data_curr->rh/10.0;
+			num_data++;
+		}
+		free_data(data_first);
+		
+		sprintf(start, "%04i-%02i-%02i %02i:%02i:%02i",
+			config_time_year(&cfg), config_time_mon(&cfg), config_time_mday(&cfg),
+			config_time_hour(&cfg), config_time_min(&cfg), config_time_sec(&cfg));
+		sprintf(num_rec, "%i", num_data);
+		sprintf(interval, "%i", config_interval(&cfg));
+		
+		if (0 != arrow_write_batch(&af, num_data, time, temp, rh, 3, batch_meta))
+		{
+			ret = 1;
+			break;
+		}
+	}
+	
+	if (0 != arrow_close(&af))
+		ret = 1;
+	
+	/* no file that looks complete but is not */
+	if (ret != 0)
+		unlink(path);
+	fclose(dumpfile);
+	free(time);
+	free(temp);
+	free(rh);
+	return ret;
+}
+
+
+int                    /* return value: 0 = success */
+convert_gnuplot(
+	char *dumpfile_path /* file written by store_data */
+) {
+	struct gnuplot_file gf;
+	struct config cfg;
+	struct data *data_first, *data_curr;
+	FILE *dumpfile;
+	char path[1024], *name, *ext;
+	int ret = 0;
+	
+	dumpfile = fopen(dumpfile_path, "r");
+	if (dumpfile == NULL)
+	{
+		printf("convert_gnuplot: failed to fopen(\"%s\", \"r\")\n", dumpfile_path);
+		return 1;
+	}
+	
+	/* LOGNAME.dat --> LOGNAME.bin and LOGNAME.plt */
+	snprintf(path, sizeof(path), "%s", dumpfile_path);
+	ext = strrchr(path, '.');
+	if (ext != NULL && 0 == strcmp(ext, ".dat"))
+		*ext = 0;
+	name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+	
+	printf("writing log data to %s.bin\n", path);
+	if (0 != gnuplot_open(&gf, path))
+	{
+		fclose(dumpfile);
+		return 1;
+	}
+	
+	/* session by session, so memory stays bounded by the session size */
+	memset(&cfg, 0, sizeof(cfg));
+	while (ret == 0 && (data_first = load_data(dumpfile, &cfg)) != NULL)
+	{
+		for (data_curr = data_first; ret == 0 && data_curr != NULL; data_curr = data_curr->next)
+			ret = gnuplot_add(&gf, data_curr->time, data_curr->temp/10.0, data_curr->rh/10.0);
+		free_data(data_first);
+	}
+	fclose(dumpfile);
+	
+	if (0 != gnuplot_close(&gf, name) || ret != 0)
+		return 1;
+	printf("plot with 'gnuplot -persist %s.plt'\n", path);
+	return 0;
+}
+
+
+int                    /* return value: 0 = success */
+store_db(
+	struct config *cfg,
+	struct data *data_first,
+	char *path          /* SQLite database */
+) {
+	struct db db;
+	char name[17];
+	int ret;
+	
+	snprintf(name, sizeof(name), "%.16s", config_name(cfg));
+	printf("writing log data to %s\n", path);
+	if (0 != db_open(&db, path))
+		return 1;
+	ret = db_session(&db, name, cfg, 1);
+	if (ret == 0)
+		ret = db_add(&db, data_first);
+	if (0 != db_close(&db))
+		ret = 1;
+	return ret;
+}
+
+
+int                    /* return value: 0 = success */
+convert_db(
+	char *dumpfile_path, /* file written by store_data */
+	char *path           /* SQLite database */
+) {
+	struct db db;
+	struct config cfg;
+	struct data *data_first;
+	struct timespec begin, end;
+	FILE *dumpfile;
+	char name[17], *base, *ext;
+	double sec;
+	int ret = 0;
+	
+	dumpfile = fopen(dumpfile_path, "r");
+	if (dumpfile == NULL)
+	{
+		printf("convert_db: failed to fopen(\"%s\", \"r\")\n", dumpfile_path);
+		return 1;
+	}
+	
+	/* the logger name is the file name without .dat */
+	base = strrchr(dumpfile_path, '/') ? strrchr(dumpfile_path, '/') + 1 : dumpfile_path;
+	snprintf(name, sizeof(name), "%.16s", base);
+	ext = strrchr(name, '.');
+	if (ext != NULL && 0 == strcmp(ext, ".dat"))
+		*ext = 0;
+	
+	printf("writing log data to %s\n", path);
+	if (0 != db_open(&db, path))
+	{
+		fclose(dumpfile);
+		return 1;
+	}
+	
+	/* session by session, so memory stays bounded by the session size */
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	memset(&cfg, 0, sizeof(cfg));
+	while (ret == 0 && (data_first = load_data(dumpfile, &cfg)) != NULL)
+	{
+		ret = db_session(&db, name, &cfg, 0);
+		if (ret == 0)
+			ret = db_add(&db, data_first);
+		free_data(data_first);
+	}
+	fclose(dumpfile);
+	
+	if (0 != db_close(&db))
+		ret = 1;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	sec = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+	printf("num_data = %lli (%.3f sec, %.0f per sec)\n", db.num_data, sec, sec > 0 ? db.num_data / sec : 0);
+	return ret;
+}
+
+
+int                    /* return value: 0 = success */
+render_data(
+	struct config *cfg,
+	struct data *data_first,
+	char *path          /* .svg or .png file */
+) {
+	struct chart ch;
+	struct data *data_curr;
+	long long time_min = 0, time_max = 0;
+	char title[17];
+	int ret;
+	
+	if (data_first == NULL)
+		return 0;
+	
+	for (data_curr = data_first; data_curr != NULL; data_curr = data_curr->next)
+	{
+		if (data_curr == data_first || data_curr->time < time_min)
+			time_min = data_curr->time;
+		if (data_curr == data_first || data_curr->time > time_max)
+			time_max = data_curr->time;
+	}
+	
+	chart_init(&ch, CHART_WIDTH, CHART_HEIGHT, time_min, time_max);
+	for (data_curr = data_first; data_curr != NULL; data_curr = data_curr->next)
+		chart_add(&ch, data_curr->time, data_curr->temp, data_curr->rh);
+	
+	snprintf(title, sizeof(title), "%.16s", config_name(cfg));
+	printf("writing chart to %s\n", path);
+	ret = chart_write(&ch, path, title);
+	chart_free(&ch);
+	return ret;
+}
+
+
+int                    /* return value: 0 = success */
+render_archive(
+	char *dumpfile_path, /* file written by store_data */
+	char *path           /* .svg or .png file */
+) {
+	struct chart ch;
+	FILE *dumpfile;
+	char line[256], title[256], *pos, *ext;
+	long long stamp, time_min = 0, time_max = 0;
+	double temp, rh;
+	int num_data = 0, ret;
+	
+	dumpfile = fopen(dumpfile_path, "r");
+	if (dumpfile == NULL)
+	{
+		printf("render_archive: failed to fopen(\"%s\", \"r\")\n", dumpfile_path);
+		return 1;
+	}
+	
+	/* first pass: time range only, so the second pass can */
+	/* aggregate right away without keeping any data */
+	
+	while (fgets(line, sizeof(line), dumpfile) != NULL)
+	{
+		stamp = strtoll(line, &pos, 10);
+		if (line[0] == '#' || pos == line)
+			continue;
+		if (num_data == 0 || stamp < time_min)
+			time_min = stamp;
+		if (num_data == 0 || stamp > time_max)
+			time_max = stamp;
+		num_data++;
+	}
+	
+	chart_init(&ch, CHART_WIDTH, CHART_HEIGHT, time_min, time_max);
+	rewind(dumpfile);
+	while (fgets(line, sizeof(line), dumpfile) != NULL)
+	{
+		stamp = strtoll(line, &pos, 10);
+		if (line[0] == '#' || pos == line)
+			continue;
+		temp = strtod(pos, &pos);
+		rh = strtod(pos, &pos);
+		chart_add(&ch, stamp,
+			temp < 0 ? temp * 10 - 0.5 : temp * 10 + 0.5,
+			rh < 0 ? rh * 10 - 0.5 : rh * 10 + 0.5);
+	}
+	fclose(dumpfile);
+	
+	/* LOGNAME.dat --> LOGNAME */
+	snprintf(title, sizeof(title), "%s", strrchr(dumpfile_path, '/') ? strrchr(dumpfile_path, '/') + 1 : dumpfile_path);
+	ext = strrchr(title, '.');
+	if (ext != NULL && 0 == strcmp(ext, ".dat"))
+		*ext = 0;
+	
+	printf("writing chart of %i data points to %s\n", num_data, path);
+	ret = chart_write(&ch, path, title);
+	chart_free(&ch);
+	return ret;
+}
+
+
+int                    /* return value: 0 = success */
+join_data(
+	char *sources,      /* comma separated .dat files, "-" = downloaded data */
+	char *method,       /* nearest, linear or last */
+	int step,           /* grid step in seconds, 0 = all timestamps */
+	struct config *cfg,
+	struct data *data_first
+) {
+	struct join_source *src;
+	struct data *data_curr;
+	char *list, *path, *ext, *save = NULL;
+	int num_src = 0, max_src = 1, num_data, ret = 1, i;
+	
+	if (join_method(method) < 0)
+	{
+		printf("join_data: unknown method %s, use nearest, linear or last\n", method);
+		return 1;
+	}
+	if (step < 0)
+	{
+		printf("join_data: invalid step %i\n", step);
+		return 1;
+	}
+	
+	/* one source per comma separated entry at most */
+	for (ext = sources; *ext; ext++)
+		if (*ext == ',')
+			max_src++;
+	list = strdup(sources);
+	src = calloc(max_src, sizeof(struct join_source));
+	
+	for (path = strtok_r(list, ",", &save); path != NULL; path = strtok_r(NULL, ",", &save))
+	{
+		if (0 == strcmp(path, "-"))
+		{
+			/* the data downloaded from the logger */
+			if (cfg == NULL)
+			{
+				printf("join_data: no downloaded data\n");
+				goto done;
+			}
+			num_data = 0;
+			for (data_curr = data_first; data_curr != NULL; data_curr = data_curr->next)
+				num_data++;
+			src[num_src].time = malloc(sizeof(long long) * (num_data + 1));
+			src[num_src].temp = malloc(sizeof(short) * (num_data + 1));
+			src[num_src].rh   = malloc(sizeof(short) * (num_data + 1));
+			for (i = 0, data_curr = data_first; data_curr != NULL; data_curr = data_curr->next, i++)
+			{
+				src[num_src].time[i] = data_curr->time;
+				src[num_src].temp[i] = data_curr->temp;
+				src[num_src].rh[i]   = data_curr->rh;
+			}
+			src[num_src].num_data = num_data;
+			src[num_src].interval = config_interval(cfg);
+			snprintf(src[num_src].name, sizeof(src[num_src].name), "%.16s", config_name(cfg));
+		}
+		else
+		{
+			src[num_src].file = fopen(path, "r");
+			if (src[num_src].file == NULL)
+			{
+				printf("join_data: failed to fopen(\"%s\", \"r\")\n", path);
+				goto done;
+			}
+			/* LOGNAME.dat --> LOGNAME */
+			snprintf(src[num_src].name, sizeof(src[num_src].name), "%s",
+				strrchr(path, '/') ? strrchr(path, '/') + 1 : path);
+			ext = strrchr(src[num_src].name, '.');
+			if (ext != NULL && 0 == strcmp(ext, ".dat"))
+				*ext = 0;
+		}
+		
+		/* no blanks in column names */
+		for (ext = src[num_src].name; *ext; ext++)
+			if (*ext == ' ')
+				*ext = '_';
+		num_src++;
+	}
+	
+	ret = join_sources(src, num_src, join_method(method), step, stdout);
+	
+done:
+	for (i = 0; i < num_src; i++)
+	{
+		if (src[i].file != NULL)
+			fclose(src[i].file);
+		free(src[i].time);
+		free(src[i].temp);
+		free(src[i].rh);
+	}
+	free(src);
+	free(list);
+	return ret;
+}
+
+
+int                    /* return value: 0 = success */
+sketch_archive(
+	char *dumpfile_path, /* file written by store_data */
+	int fahrenheit       /* bool: temp in °F, the .dat file does not tell */
+) {
+	struct config cfg;
+	struct data *data_first;
+	FILE *dumpfile, *histfile;
+	char path[1024], tmp_path[1100], *ext;
+	int num_sessions = 0, ret = 0;
+	
+	/* LOGNAME.dat --> LOGNAME.hist */
+	snprintf(path, sizeof(path) - 5, "%s", dumpfile_path);
+	ext = strrchr(path, '.');
+	if (ext != NULL && 0 == strcmp(ext, ".dat"))
+		*ext = 0;
+	strcat(path, ".hist");
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	
+	dumpfile = fopen(dumpfile_path, "r");
+	if (dumpfile == NULL)
+	{
+		printf("sketch_archive: failed to fopen(\"%s\", \"r\")\n", dumpfile_path);
+		return 1;
+	}
+	histfile = fopen(tmp_path, "w");
+	if (histfile == NULL)
+	{
+		printf("sketch_archive: failed to fopen(\"%s\", \"w\")\n", tmp_path);
+		fclose(dumpfile);
+		return 1;
+	}
+	
+	memset(&cfg, 0, sizeof(cfg));
+	while (ret == 0 && (data_first = load_data(dumpfile, &cfg)) != NULL)
+	{
+		ret = hist_write(histfile, data_first, config_interval(&cfg), fahrenheit);
+		free_data(data_first);
+		num_sessions++;
+	}
+	fclose(dumpfile);
+	
+	/* replace the old sketches at once */
+	if (0 != fclose(histfile) || ret != 0 || 0 != rename(tmp_path, path))
+	{
+		printf("sketch_archive: failed to write %s\n", path);
+		unlink(tmp_path);
+		return 1;
+	}
+	printf("writing sketches of %i sessions to %s\n", num_sessions, path);
+	return 0;
+}
+
+
+long long              /* return value: time as in struct data, -1 = "-", -2 = invalid */
+query_day(
+	char *day          /* YYYY-MM-DD or "-" */
+) {
+	struct tm tm;
+	
+	if (0 == strcmp(day, "-"))
+		return -1;
+	memset(&tm, 0, sizeof(tm));
+	if (3 != sscanf(day, "%d-%d-%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday))
+		return -2;
+	tm.tm_year -= 1900;
+	tm.tm_mon -= 1;
+	return timegm(&tm);
+}
+
+
+int                    /* return value: 0 = success */
+query_sketches(
+	char *from,         /* first day, YYYY-MM-DD, "-" = no limit */
+	char *to,           /* day after the last day, YYYY-MM-DD, "-" = no limit */
+	char *bands,        /* e.g. temp:2:8,rh:30:60, "-" = none */
+	char *paths         /* comma separated .hist files */
+) {
+	static const double percentiles[] = { 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99 };
+	struct hist h;
+	unsigned long long *bins;
+	char *list, *item, *save = NULL, quantity[8], first[32], last[32];
+	long long time_from, time_to;
+	time_t stamp;
+	float low, high;
+	int num_files = 0, ret = 1, k, q;
+	
+	time_from = query_day(from);
+	time_to = query_day(to);
+	if (time_from < -1 || time_to < -1)
+	{
+		printf("query_sketches: expected YYYY-MM-DD or -\n");
+		return 1;
+	}
+	if (0 != hist_init(&h))
+		return 1;
+	
+	/* merge the sketches of all files */
+	list = strdup(paths);
+	for (item = strtok_r(list, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save))
+	{
+		if (0 != hist_read(&h, item, time_from, time_to))
+			goto done;
+		num_files++;
+	}
+	
+	if (h.total == 0)
+	{
+		printf("no data\n");
+		ret = 0;
+		goto done;
+	}
+	
+	stamp = h.time_first;
+	strftime(first, sizeof(first), "%Y-%m-%d %H:%M:%S", gmtime(&stamp));
+	stamp = h.time_last;
+	strftime(last, sizeof(last), "%Y-%m-%d %H:%M:%S", gmtime(&stamp));
+	printf("%lli data points, %.1f days of %i files, %s .. %s\n",
+		h.num_data, h.total / 86400.0, num_files, first, last);
+	
+	for (q = 0; q < 2; q++)
+	{
+		bins = q == 0 ? h.temp : h.rh;
+		printf("%s: min %.1f", q == 0 ? "temp" : "rh", hist_percentile(bins, h.total, 0) / 10.0);
+		for (k = 0; k < sizeof(percentiles) / sizeof(percentiles[0]); k++)
+			printf(" p%g %.1f", percentiles[k] * 100, hist_percentile(bins, h.total, percentiles[k]) / 10.0);
+		printf(" max %.1f %s\n", hist_percentile(bins, h.total, 1) / 10.0,
+			q == 1 ? "%" : h.fahrenheit ? "°F" : "°C");
+	}
+	
+	/* share of time in each band, limits included */
+	if (0 != strcmp(bands, "-"))
+	{
+		free(list);
+		list = strdup(bands);
+		for (item = strtok_r(list, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save))
+		{
+			if (3 != sscanf(item, "%7[a-z]:%f:%f", quantity, &low, &high) ||
+				(0 != strcmp(quantity, "temp") && 0 != strcmp(quantity, "rh")))
+			{
+				printf("query_sketches: invalid band %s, expected temp|rh:LOW:HIGH\n", item);
+				goto done;
+			}
+			bins = 0 == strcmp(quantity, "temp") ? h.temp : h.rh;
+			printf("%s %.1f .. %.1f: %.2f%% of the time\n", quantity, low, high,
+				100.0 * hist_band(bins, low * 10 + (low < 0 ? -0.5 : 0.5), high * 10 + (high < 0 ? -0.5 : 0.5)) / h.total);
+		}
+	}
+	ret = 0;
+	
+done:
+	free(list);
+	hist_free(&h);
+	return ret;
+}
+
+
+/* LOGNAME.dat --> LOGNAME.EXT */
+void
+tier_path(
+	char *path,          /* result, 1024 bytes */
+	char *dumpfile_path, /* file written by store_data */
+	char *ext            /* e.g. "hourly" */
+) {
+	char *pos;
+	
+	snprintf(path, 1000, "%s", dumpfile_path);
+	pos = strrchr(path, '.');
+	if (pos != NULL && 0 == strcmp(pos, ".dat"))
+		*pos = 0;
+	strcat(path, ".");
+	strncat(path, ext, 16);
+}
+
+
+int                    /* return value: 0 = success */
+compact_archive(
+	char *dumpfile_path, /* file written by store_data */
+	int days,            /* roll up sessions older than this */
+	int keep             /* bool: keep them in dumpfile_path, too */
+) {
+	struct rollup_tier hourly, daily;
+	FILE *dumpfile, *newfile = NULL;
+	char hourly_path[1024], daily_path[1024], dir_path[1024], tmp_path[1100], line[256], *pos;
+	long long *session_last = NULL, stamp, limit;
+	int num_sessions = 0, cap = 0, session, in_data, old;
+	int num_rolled = 0, num_dropped = 0, temp_tenths, rh_tenths, fds[2], synced, ret = 1;
+	struct tm now;
+	time_t now_stamp;
+	double temp, rh;
+	
+	tier_path(hourly_path, dumpfile_path, "hourly");
+	tier_path(daily_path, dumpfile_path, "daily");
+	if (0 != rollup_load(&hourly, hourly_path, ROLLUP_HOUR) ||
+		0 != rollup_load(&daily, daily_path, ROLLUP_DAY))
+		goto done;
+	
+	/* data times are the local wall clock */
+	now_stamp = time(NULL);
+	localtime_r(&now_stamp, &now);
+	limit = (long long)now_stamp + now.tm_gmtoff - (long long)days * 86400;
+	
+	dumpfile = fopen(dumpfile_path, "r");
+	if (dumpfile == NULL)
+	{
+		printf("compact_archive: failed to fopen(\"%s\", \"r\")\n", dumpfile_path);
+		goto done;
+	}
+	
+	/* first pass: last time of each session, see load_data for where they start */
+	
+	in_data = 1;
+	while (fgets(line, sizeof(line), dumpfile) != NULL)
+	{
+		/* a trailer ends its session, see archive.c */
+		if (archive_is_trailer(line))
+			continue;
+		if (line[0] == '#' || num_sessions == 0)
+		{
+			if (in_data)
+			{
+				if (num_sessions == cap)
+				{
+					cap = cap ? cap * 2 : 64;
+					session_last = realloc(session_last, cap * sizeof(long long));
+				}
+				session_last[num_sessions++] = -1;
+			}
+			in_data = line[0] != '#';
+			if (line[0] == '#')
+				continue;
+		}
+		stamp = strtoll(line, &pos, 10);
+		if (pos == line)
+			continue;
+		in_data = 1;
+		if (stamp > session_last[num_sessions-1])
+			session_last[num_sessions-1] = stamp;
+	}
+	
+	/* second pass: roll up the old sessions, copy the others */
+	
+	if (!keep)
+	{
+		snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", dumpfile_path);
+		newfile = fopen(tmp_path, "w");
+		if (newfile == NULL)
+		{
+			printf("compact_archive: failed to fopen(\"%s\", \"w\")\n", tmp_path);
+			fclose(dumpfile);
+			goto done;
+		}
+	}
+	rewind(dumpfile);
+	session = -1;
+	in_data = 1;
+	while (fgets(line, sizeof(line), dumpfile) != NULL)
+	{
+		if (((line[0] == '#' && !archive_is_trailer(line)) || session < 0) && in_data)
+		{
+			session++;
+			in_data = 0;
+		}
+		old = session_last[session] >= 0 && session_last[session] < limit;
+		if (newfile != NULL && !old)
+			fputs(line, newfile);
+		if (line[0] == '#')
+			continue;
+	
+		stamp = strtoll(line, &pos, 10);
+		if (pos == line)
+			continue;
+		in_data = 1;
+		if (old)
+			num_dropped++;
+		/* each tier on its own, a run cut short may have saved only one */
+		if (!old || (stamp <= hourly.rolled && stamp <= daily.rolled))
+			continue;
+		temp = strtod(pos, &pos);
+		rh = strtod(pos, &pos);
+		temp_tenths = temp < 0 ? temp * 10 - 0.5 : temp * 10 + 0.5;
+		rh_tenths = rh * 10 + 0.5;
+		if (stamp > hourly.rolled)
+			rollup_add(&hourly, stamp, temp_tenths, rh_tenths);
+		if (stamp > daily.rolled)
+			rollup_add(&daily, stamp, temp_tenths, rh_tenths);
+		num_rolled++;
+	}
+	fclose(dumpfile);
+	
+	/* the tiers first, so a crash in between loses nothing */
+	if (num_rolled > 0 &&
+		(0 != rollup_save(&hourly, hourly_path) || 0 != rollup_save(&daily, daily_path)))
+	{
+		if (newfile != NULL)
+		{
+			fclose(newfile);
+			unlink(tmp_path);
+		}
+		goto done;
+	}
+	printf("rolled up %i data points into %s and %s\n", num_rolled, hourly_path, daily_path);
+	
+	if (newfile != NULL)
+	{
+		/* on disk before it replaces the archive, and so are the renames of the tiers */
+		snprintf(dir_path, sizeof(dir_path), "%s", dumpfile_path);
+		pos = strrchr(dir_path, '/');
+		if (pos == NULL)
+			strcpy(dir_path, ".");
+		else
+			pos[pos == dir_path] = '\0';
+		fds[0] = fileno(newfile);
+		fds[1] = open(dir_path, O_RDONLY | O_DIRECTORY);
+		synced = fds[1] >= 0 && 0 == fflush(newfile) && 0 == archive_commit(fds, 2);
+		if (fds[1] >= 0)
+			close(fds[1]);
+		if (0 != fclose(newfile) || !synced || 0 != rename(tmp_path, dumpfile_path))
+		{
+			printf("compact_archive: failed to write %s\n", dumpfile_path);
+			unlink(tmp_path);
+			goto done;
+		}
+		printf("dropped %i data points from %s\n", num_dropped, dumpfile_path);
+	}
+	ret = 0;
 	
-	return data_first;
-}	
+done:
+	free(session_last);
+	rollup_free(&hourly);
+	rollup_free(&daily);
+	return ret;
+}
 
 
 void
-print_data(
-	struct data *data_first
+query_print(
+	struct rollup_bucket *b
 ) {
-	struct data *data_curr;
-	data_curr = data_first;
+	double temp_mean, rh_mean, temp_var, rh_var;
 	
-	if (data_curr == NULL)
+	if (b->count == 0)
 		return;
-	
-	do {
-		
-		printf("%i %.1f %.1f\n", (int)data_curr->time, data_curr->temp/10.0, data_curr->rh/10.0);
-		data_curr = data_curr->next;
-		
-	} while (data_curr != NULL);
+	temp_mean = (double)b->temp_sum / b->count;
+	rh_mean = (double)b->rh_sum / b->count;
+	temp_var = (double)b->temp_sumsq / b->count - temp_mean * temp_mean;
+	rh_var = (double)b->rh_sumsq / b->count - rh_mean * rh_mean;
+	printf("%lld %lld %.1f %.1f %.2f %.2f %.1f %.1f %.2f %.2f\n", b->start, b->count,
+		b->temp_min / 10.0, b->temp_max / 10.0, temp_mean / 10, temp_var > 0 ? sqrt(temp_var) / 10 : 0,
+		b->rh_min / 10.0, b->rh_max / 10.0, rh_mean / 10, rh_var > 0 ? sqrt(rh_var) / 10 : 0);
 }
 
 
-void
-store_data(
-	struct config *cfg,
-	struct data *data_first
+int                    /* return value: 0 = success */
+query_rollup(
+	char *from,          /* first day, YYYY-MM-DD, "-" = no limit */
+	char *to,            /* day after the last day, YYYY-MM-DD, "-" = no limit */
+	int step,            /* bucket width in seconds */
+	char *dumpfile_path  /* file written by store_data */
 ) {
-	struct data *data_curr;
-	char dumpfile_path[1024];
-	FILE *dumpfile = NULL;
+	struct rollup_bucket out, b;
+	FILE *file;
+	char path[1024], line[256], *pos;
+	long long time_from, time_to, rolled = -1, first_rolled = -1;
+	double temp, rh;
+	int width, seen = 0;
 	
-	data_curr = data_first;
-	if (data_curr == NULL)
-		return;
+	time_from = query_day(from);
+	time_to = query_day(to);
+	if (time_from < -1 || time_to < -1 || step <= 0)
+	{
+		printf("query_rollup: expected YYYY-MM-DD or - and a STEP > 0\n");
+		return 1;
+	}
+	memset(&out, 0, sizeof(out));
+	printf("# time count temp_min temp_max temp_mean temp_sd rh_min rh_max rh_mean rh_sd\n");
 	
-	sprintf(dumpfile_path, "%s.dat", cfg->name),
-	dumpfile = fopen(dumpfile_path, "a");
-	if (dumpfile == NULL)
+	/* the coarsest tier that fits the step, for the time it covers */
+	
+	file = NULL;
+	if (step % ROLLUP_DAY == 0)
 	{
-		printf("store_data: failed to fopen(\"%s\", \"a+\")", dumpfile_path);
-		return;
+		tier_path(path, dumpfile_path, "daily");
+		file = fopen(path, "r");
+	}
+	if (file == NULL && step % ROLLUP_HOUR == 0)
+	{
+		tier_path(path, dumpfile_path, "hourly");
+		file = fopen(path, "r");
+	}
+	if (file != NULL)
+	{
+		if (0 != rollup_header(file, &width, &rolled) || step % width != 0)
+		{
+			printf("query_rollup: %s is not a valid rollup\n", path);
+			fclose(file);
+			return 1;
+		}
+		while (0 == rollup_next(file, &b))
+		{
+			if ((time_from >= 0 && b.start < time_from) || (time_to >= 0 && b.start >= time_to))
+				continue;
+			b.start -= (b.start % step + step) % step;
+			if (b.start != out.start)
+			{
+				query_print(&out);
+				memset(&out, 0, sizeof(out));
+				out.start = b.start;
+			}
+			rollup_merge(&out, &b);
+		}
+		fclose(file);
+	}
+	else if (step % ROLLUP_HOUR != 0)
+	{
+		/* no tier fits, the raw data has to cover the rolled up time, too */
+		tier_path(path, dumpfile_path, "hourly");
+		file = fopen(path, "r");
+		if (file != NULL && 0 == rollup_header(file, &width, &rolled))
+			while (first_rolled < 0 && 0 == rollup_next(file, &b))
+				if ((time_from < 0 || b.start >= time_from) && (time_to < 0 || b.start < time_to))
+					first_rolled = b.start;
+		if (file != NULL)
+			fclose(file);
+		rolled = -1;
 	}
-	printf("writing log data to %s\n", dumpfile_path);
-	
-	fprintf(dumpfile, "# [%04i-%02i-%02i %02i:%02i:%02i] %i points @ %i sec\n",
-		cfg->time_year,
-		cfg->time_mon,
-		cfg->time_mday,
-		cfg->time_hour,
-		cfg->time_min,
-		cfg->time_sec,
-		cfg->num_data_rec,
-		cfg->interval
-	);
-	do {
-		fprintf(dumpfile, "%i %.1f %.1f\n", (int)data_curr->time, data_curr->temp/10.0, data_curr->rh/10.0);
-		data_curr = data_curr->next;
-	} while (data_curr != NULL);
-
-printf("data_curr->next = %p\n", data_curr->next);
 	
-	fclose(dumpfile);
+	/* the raw data for the rest */
+	
+	file = fopen(dumpfile_path, "r");
+	if (file == NULL)
+	{
+		printf("query_rollup: failed to fopen(\"%s\", \"r\")\n", dumpfile_path);
+		return 1;
+	}
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		b.start = strtoll(line, &pos, 10);
+		if (line[0] == '#' || pos == line || b.start <= rolled ||
+			(time_from >= 0 && b.start < time_from) || (time_to >= 0 && b.start >= time_to))
+			continue;
+		if (!seen++ && first_rolled >= 0 && b.start >= first_rolled + ROLLUP_HOUR)
+			break;
+		temp = strtod(pos, &pos);
+		rh = strtod(pos, &pos);
+		b.count = 1;
+		b.temp_min = b.temp_max = b.temp_sum = temp < 0 ? temp * 10 - 0.5 : temp * 10 + 0.5;
+		b.temp_sumsq = (long long)b.temp_sum * b.temp_sum;
+		b.rh_min = b.rh_max = b.rh_sum = rh * 10 + 0.5;
+		b.rh_sumsq = (long long)b.rh_sum * b.rh_sum;
+		b.start -= (b.start % step + step) % step;
+		if (b.start != out.start)
+		{
+			query_print(&out);
+			memset(&out, 0, sizeof(out));
+			out.start = b.start;
+		}
+		rollup_merge(&out, &b);
+	}
+	fclose(file);
+	if (first_rolled >= 0 && out.count == 0)
+	{
+		/* -o dropped it from the archive */
+		printf("query_rollup: the data from %lld on is rolled up, use a STEP of a multiple of %i sec\n",
+			first_rolled, ROLLUP_HOUR);
+		return 1;
+	}
+	query_print(&out);
+	return 0;
 }
 
-
 void
 print_config(
 	struct config *cfg, /* config struct */
 	char *line_prefix   /* prefix to print before each line */
 ) {
-	//printf("%sconfig_begin =       0x%02x\n", line_prefix, cfg->config_begin);
-	printf("%sname =               %s\n",   line_prefix, cfg->name);
-	printf("%snum_data_conf =      %i\n",   line_prefix, cfg->num_data_conf);
-	printf("%snum_data_rec =       %i\n",   line_prefix, cfg->num_data_rec);
-	printf("%sinterval =           %i\n",   line_prefix, cfg->interval);
-	printf("%stime_year =          %i\n",   line_prefix, cfg->time_year);
-	printf("%stime_mon =           %i\n",   line_prefix, cfg->time_mon);
-	printf("%stime_mday =          %i\n",   line_prefix, cfg->time_mday);
-	printf("%stime_hour =          %i\n",   line_prefix, cfg->time_hour);
-	printf("%stime_min =           %i\n",   line_prefix, cfg->time_min);
-	printf("%stime_sec =           %i\n",   line_prefix, cfg->time_sec);
-	printf("%stemp_is_fahrenheit = %i\n",   line_prefix, cfg->temp_is_fahrenheit);
+	//printf("%sconfig_begin =       0x%02x\n", line_prefix, config_config_begin(cfg));
+	printf("%sname =               %.16s\n",   line_prefix, config_name(cfg));
+	printf("%snum_data_conf =      %i\n",   line_prefix, config_num_data_conf(cfg));
+	printf("%snum_data_rec =       %i\n",   line_prefix, config_num_data_rec(cfg));
+	printf("%sinterval =           %i\n",   line_prefix, config_interval(cfg));
+	printf("%stime_year =          %i\n",   line_prefix, config_time_year(cfg));
+	printf("%stime_mon =           %i\n",   line_prefix, config_time_mon(cfg));
+	printf("%stime_mday =          %i\n",   line_prefix, config_time_mday(cfg));
+	printf("%stime_hour =          %i\n",   line_prefix, config_time_hour(cfg));
+	printf("%stime_min =           %i\n",   line_prefix, config_time_min(cfg));
+	printf("%stime_sec =           %i\n",   line_prefix, config_time_sec(cfg));
+	printf("%stemp_is_fahrenheit = %i\n",   line_prefix, config_temp_is_fahrenheit(cfg));
 	printf("%sled_conf =           0x%02x (freq=%i, alarm=%i)\n",
-		line_prefix, cfg->led_conf, (cfg->led_conf & 0x1F), (cfg->led_conf & 0x80 >> 7));
-	printf("%sstart =              0x%02x", line_prefix, cfg->start);
-	if (cfg->start == 1)
+		line_prefix, config_led_conf(cfg), (config_led_conf(cfg) & 0x1F), (config_led_conf(cfg) & 0x80 >> 7));
+	printf("%sstart =              0x%02x", line_prefix, config_start(cfg));
+	if (config_start(cfg) == 1)
 		printf(" (manual)");
-	if (cfg->start == 2)
+	if (config_start(cfg) == 2)
 		printf(" (automatic)");
 	printf("\n");
-	printf("%sthresh_temp_low =    %i\n",   line_prefix, bin2num(cfg->thresh_temp_low));
-	printf("%sthresh_temp_high =   %i\n",   line_prefix, bin2num(cfg->thresh_temp_high));
-	printf("%sthresh_rh_low =      %i\n",   line_prefix, bin2num(cfg->thresh_rh_low));
-	printf("%sthresh_rh_high =     %i\n",   line_prefix, bin2num(cfg->thresh_rh_high));
-	//printf("%sconfig_end =         0x%02x\n", line_prefix, cfg->config_end);
+	printf("%sthresh_temp_low =    %i\n",   line_prefix, config_thresh_temp_low(cfg));
+	printf("%sthresh_temp_high =   %i\n",   line_prefix, config_thresh_temp_high(cfg));
+	printf("%sthresh_rh_low =      %i\n",   line_prefix, config_thresh_rh_low(cfg));
+	printf("%sthresh_rh_high =     %i\n",   line_prefix, config_thresh_rh_high(cfg));
+	//printf("%sconfig_end =         0x%02x\n", line_prefix, config_config_end(cfg));
 }
 
 
@@ -599,13 +3456,13 @@ build_config(
 	}
 	memset(cfg, 0, sizeof(*cfg));
 	
-	cfg->config_begin = 0xce;
-	cfg->config_end = 0xce;
+	config_set_config_begin(cfg, 0xce);
+	config_set_config_end(cfg, 0xce);
 	
-	cfg->start = start;
+	config_set_start(cfg, start);
 	
-	cfg->num_data_conf = num_data;
-	cfg->interval = interval;
+	config_set_num_data_conf(cfg, num_data);
+	config_set_interval(cfg, interval);
 	
 	time_t now_stamp = 0;
 	now_stamp = time(NULL);
@@ -616,24 +3473,24 @@ build_config(
 		printf("build_config: failed to get localtime\n");
 		return NULL;
 	}
-	cfg->time_year = now->tm_year + 1900;
-	cfg->time_mon  = now->tm_mon + 1;
-	cfg->time_mday = now->tm_mday;
-	cfg->time_hour = now->tm_hour;
-	cfg->time_min  = now->tm_min;
-	cfg->time_sec  = now->tm_sec;
+	config_set_time_year(cfg, now->tm_year + 1900);
+	config_set_time_mon(cfg, now->tm_mon + 1);
+	config_set_time_mday(cfg, now->tm_mday);
+	config_set_time_hour(cfg, now->tm_hour);
+	config_set_time_min(cfg, now->tm_min);
+	config_set_time_sec(cfg, now->tm_sec);
 	
-	cfg->thresh_temp_low  = num2bin(thresh_temp_low);
-	cfg->thresh_temp_high = num2bin(thresh_temp_high);
+	config_set_thresh_temp_low(cfg, thresh_temp_low);
+	config_set_thresh_temp_high(cfg, thresh_temp_high);
 	
-	cfg->temp_is_fahrenheit = temp_is_fahrenheit & 1;
+	config_set_temp_is_fahrenheit(cfg, temp_is_fahrenheit & 1);
 	
-	cfg->led_conf = (led_alarm & 1 << 7) | (led_freq & 0x1F);
+	config_set_led_conf(cfg, (led_alarm & 1 << 7) | (led_freq & 0x1F));
 	
-	strncpy(cfg->name, name, 16);
+	config_set_name(cfg, name);
 	
-	cfg->thresh_rh_low  = num2bin(thresh_rh_low);
-	cfg->thresh_rh_high = num2bin(thresh_rh_high);
+	config_set_thresh_rh_low(cfg, thresh_rh_low);
+	config_set_thresh_rh_high(cfg, thresh_rh_high);
 	
 	return cfg;
 }
@@ -644,80 +3501,80 @@ check_config(
 	struct config *cfg /* config struct */
 ) {
 	
-	if (0 == strlen(cfg->name))
+	if (0 == strnlen(config_name(cfg), 16))
 	{
 		printf("check_config: empty name\n");
 		return 1;
 	}
 	
-	if (cfg->num_data_conf <= 0 || 16000 < cfg->num_data_conf)
+	if (config_num_data_conf(cfg) <= 0 || 16000 < config_num_data_conf(cfg))
 	{
 		printf("check_config: invalid num_data_conf, valid range: [1:16000]\n");
 		return 1;
 	}
 	
-	if (cfg->interval <= 0 || 86400 < cfg->interval)
+	if (config_interval(cfg) <= 0 || 86400 < config_interval(cfg))
 	{
 		printf("check_config: invalid interval, valid range: [1:86400]\n");
 		return 1;
 	}
 	
-	if (cfg->start != 1 && cfg->start != 2)
+	if (config_start(cfg) != 1 && config_start(cfg) != 2)
 	{
 		printf("check_config: invalid start flag\n");
 		return 1;
 	}
 	
-	if (cfg->temp_is_fahrenheit)
+	if (config_temp_is_fahrenheit(cfg))
 	{
-		if (bin2num(cfg->thresh_temp_low) < TEMP_MIN || TEMP_MAX_F < bin2num(cfg->thresh_temp_low))
+		if (config_thresh_temp_low(cfg) < TEMP_MIN || TEMP_MAX_F < config_thresh_temp_low(cfg))
 		{
 			printf("check_config: invalid thresh_temp_low\n");
 			return 1;
 		}
-		if (bin2num(cfg->thresh_temp_high) < TEMP_MIN || TEMP_MAX_F < bin2num(cfg->thresh_temp_high))
+		if (config_thresh_temp_high(cfg) < TEMP_MIN || TEMP_MAX_F < config_thresh_temp_high(cfg))
 		{
 			printf("check_config: invalid thresh_temp_high\n");
 			return 1;
 		}
 	} else {
-		if (bin2num(cfg->thresh_temp_low) < TEMP_MIN || TEMP_MAX_C < bin2num(cfg->thresh_temp_low))
+		if (config_thresh_temp_low(cfg) < TEMP_MIN || TEMP_MAX_C < config_thresh_temp_low(cfg))
 		{
 			printf("check_config: invalid thresh_temp_low\n");
 			return 1;
 		}
-		if (bin2num(cfg->thresh_temp_high) < TEMP_MIN || TEMP_MAX_C < bin2num(cfg->thresh_temp_high))
+		if (config_thresh_temp_high(cfg) < TEMP_MIN || TEMP_MAX_C < config_thresh_temp_high(cfg))
 		{
 			printf("check_config: invalid thresh_temp_high\n");
 			return 1;
 		}
 	}
 	
-	if (bin2num(cfg->thresh_temp_high) < bin2num(cfg->thresh_temp_low))
+	if (config_thresh_temp_high(cfg) < config_thresh_temp_low(cfg))
 	{
 		printf("check_config: invalid thresh_temp_low/high\n");
 		return 1;
 	}
 	
-	if (bin2num(cfg->thresh_rh_low) < RH_MIN || RH_MAX < bin2num(cfg->thresh_rh_low))
+	if (config_thresh_rh_low(cfg) < RH_MIN || RH_MAX < config_thresh_rh_low(cfg))
 	{
 		printf("check_config: invalid thresh_rh_low\n");
 		return 1;
 	}
 	
-	if (bin2num(cfg->thresh_rh_high) < RH_MIN || RH_MAX < bin2num(cfg->thresh_rh_high))
+	if (config_thresh_rh_high(cfg) < RH_MIN || RH_MAX < config_thresh_rh_high(cfg))
 	{
 		printf("check_config: invalid thresh_rh_high\n");
 		return 1;
 	}
 	
-	if (bin2num(cfg->thresh_rh_high) < bin2num(cfg->thresh_rh_low))
+	if (config_thresh_rh_high(cfg) < config_thresh_rh_low(cfg))
 	{
 		printf("check_config: invalid thresh_rh_low/high\n");
 		return 1;
 	}
 	
-	int led_freq = cfg->led_conf & 0x1F;
+	int led_freq = config_led_conf(cfg) & 0x1F;
 	if (led_freq != 10 && led_freq != 20 && led_freq != 30)
 	{
 		printf("check_config: invalid led_conf (freq)\n");
@@ -727,16 +3584,139 @@ check_config(
 	return 0;
 }
 
+int                    /* return value: number of arguments, -1 = unknown command */
+command_args(
+	char *command      /* command line switch, e.g. "-c" */
+) {
+	if (0 == strcmp(command, "-c"))
+		return 3;
+	if (0 == strcmp(command, "-A") ||
+		0 == strcmp(command, "-x") ||
+		0 == strcmp(command, "-d") ||
+		0 == strcmp(command, "-S") ||
+		0 == strcmp(command, "-l") ||
+		0 == strcmp(command, "-g") ||
+		0 == strcmp(command, "-r") ||
+		0 == strcmp(command, "-H"))
+		return 1;
+	if (0 == strcmp(command, "-G") ||
+		0 == strcmp(command, "-D") ||
+		0 == strcmp(command, "-F"))
+		return 2;
+	if (0 == strcmp(command, "-j"))
+		return 3;
+	if (0 == strcmp(command, "-q") ||
+		0 == strcmp(command, "-b"))
+		return 4;
+	if (0 == strcmp(command, "-o") ||
+		0 == strcmp(command, "-w"))
+		return 3;
+	if (0 == strcmp(command, "-i") ||
+		0 == strcmp(command, "-p") ||
+		0 == strcmp(command, "-s") ||
+		0 == strcmp(command, "-a") ||
+		0 == strcmp(command, "-f"))
+		return 0;
+	return -1;
+}
+
 int main (int argc, char **argv)
 {
+	
+	/* global options, shifted out of argv before the command */
+	
+	while (argc > 1)
+	{
+		if (argc > 2 && 0 == strcmp(argv[1], "-R"))
+		{
+			if (0 != transcript_open(argv[2], 0))
+				return 1;
+			argv[2] = argv[0]; argv += 2; argc -= 2;
+		}
+		else if (argc > 2 && 0 == strcmp(argv[1], "-P"))
+		{
+			if (0 != transcript_open(argv[2], 1))
+				return 1;
+			argv[2] = argv[0]; argv += 2; argc -= 2;
+		}
+		else if (0 == strcmp(argv[1], "-T"))
+		{
+			transcript_timing = 1;
+			argv[1] = argv[0]; argv += 1; argc -= 1;
+		}
+		else if (argc > 2 && 0 == strcmp(argv[1], "-C"))
+		{
+			if (0 != calib_load(argv[2]))
+				return 1;
+			argv[2] = argv[0]; argv += 2; argc -= 2;
+		}
+		else if (0 == strcmp(argv[1], "-K"))
+		{
+			calib_keep_raw = 1;
+			argv[1] = argv[0]; argv += 1; argc -= 1;
+		}
+		else if (argc > 3 && 0 == strcmp(argv[1], "-M"))
+		{
+			stats_window = atoi(argv[2]);
+			stats_tau = atoi(argv[3]);
+			if (stats_window <= 0)
+			{
+				printf("-M: WINDOW must be > 0\n");
+				return 1;
+			}
+			argv[3] = argv[0]; argv += 3; argc -= 3;
+		}
+		else if (argc > 2 && 0 == strcmp(argv[1], "-L"))
+		{
+			if (0 != live_open(argv[2]))
+				return 1;
+			argv[2] = argv[0]; argv += 2; argc -= 2;
+		}
+		else if (argc > 4 && 0 == strcmp(argv[1], "-I"))
+		{
+			if (0 != influx_open(argv[2], atoi(argv[3]), atoi(argv[4])))
+				return 1;
+			argv[4] = argv[0]; argv += 4; argc -= 4;
+		}
+		else
+			break;
+	}
 
 	if (argc < 2)
 	{
-		printf("usage:\n"),
+		printf("usage: %s [OPTIONS] COMMAND [COMMAND...]\n", argv[0]);
+		printf("commands, run in the given order on one logger connection:\n");
 		printf("  %s -c LOGNAME NUM_DATA INTERVAL  -->  configure logger\n", argv[0]);
 		printf("  %s -i  -->  print config\n", argv[0]);
 		printf("  %s -p  -->  print data\n", argv[0]);
 		printf("  %s -s  -->  store data in LOGNAME.dat\n", argv[0]);
+		printf("  %s -f  -->  follow data while logging\n", argv[0]);
+		printf("  %s -a  -->  store data in LOGNAME.arrow\n", argv[0]);
+		printf("  %s -A FILE.dat  -->  convert stored data to FILE.arrow\n", argv[0]);
+		printf("  %s -x FILE.dat  -->  convert stored data to FILE.bin and FILE.plt for gnuplot\n", argv[0]);
+		printf("  %s -d FILE.db  -->  store data in the SQLite database FILE.db\n", argv[0]);
+		printf("  %s -D FILE.dat FILE.db  -->  convert stored data to the SQLite database FILE.db\n", argv[0]);
+		printf("  %s -g FILE  -->  render data as chart, FILE.svg or FILE.png\n", argv[0]);
+		printf("  %s -G FILE.dat FILE  -->  render stored data as chart\n", argv[0]);
+		printf("  %s -j METHOD STEP FILE.dat,...  -->  join data on a common time grid\n", argv[0]);
+		printf("  %s -S FILE.dat  -->  rebuild the histogram sketches FILE.hist\n", argv[0]);
+		printf("  %s -q FROM TO BANDS FILE.hist,...  -->  percentiles and time in BANDS from sketches\n", argv[0]);
+		printf("  %s -o DAYS KEEP FILE.dat  -->  roll data older than DAYS into FILE.hourly and FILE.daily\n", argv[0]);
+		printf("  %s -b FROM TO STEP FILE.dat  -->  min, max, mean of each STEP sec, from the coarsest rollup\n", argv[0]);
+		printf("  %s -r MARGIN  -->  store data and re-arm logger MARGIN sec before it is full, repeatedly\n", argv[0]);
+		printf("  %s -F PER_BUS MARGIN  -->  like -r for all loggers, max PER_BUS transfers per usb bus\n", argv[0]);
+		printf("  %s -H REARM  -->  store data of each logger plugged in, REARM = 1: start a new log\n", argv[0]);
+		printf("  %s -w HOOK HYST HOLDOFF  -->  watch all loggers, report threshold alarms to HOOK, \"-\" = none\n", argv[0]);
+		printf("  %s -l NAME  -->  print the latest readings in shared memory NAME, see -L\n", argv[0]);
+		printf("options, before the commands:\n");
+		printf("  -R FILE  -->  record usb transfers to FILE\n");
+		printf("  -P FILE  -->  replay usb transfers from FILE instead of using the logger\n");
+		printf("  -T       -->  replay with the original timing\n");
+		printf("  -C FILE  -->  calibrate the data with the profiles in FILE\n");
+		printf("  -K       -->  store raw values next to the calibrated ones\n");
+		printf("  -I DIR|unix:PATH BATCH FLUSH  -->  also send stored data as InfluxDB line protocol\n");
+		printf("  -M WINDOW TAU  -->  keep statistics of stored data in LOGNAME.stats\n");
+		printf("  -L NAME  -->  keep the latest readings in shared memory NAME, see src/vdl120shm.h\n");
 		return 1;
 	}
 	
@@ -754,6 +3734,51 @@ int main (int argc, char **argv)
 	struct usb_device *dev = NULL;
 	struct usb_dev_handle *dev_hdl = NULL;
 	
+	int status = 1;
+	int need_logger = 0;
+	struct config *cfg = NULL;      /* read once, shared by all commands */
+	struct data *data_first = NULL; /* read once, shared by all commands */
+	
+	/* check the whole command sequence before touching the logger */
+	for (i = 1; i < argc; i += 1 + command_args(argv[i]))
+	{
+		if (command_args(argv[i]) < 0)
+		{
+			printf("unknown command: %s\n", argv[i]);
+			goto cleanup;
+		}
+		if (i + command_args(argv[i]) >= argc)
+		{
+			printf("%s: missing arguments\n", argv[i]);
+			goto cleanup;
+		}
+		if (0 == strcmp(argv[i], "-j"))
+		{
+			/* only if the downloaded data takes part */
+			char *src = argv[i+3];
+			if (0 == strcmp(src, "-") || 0 == strncmp(src, "-,", 2) ||
+				strstr(src, ",-,") != NULL || (strlen(src) >= 2 && 0 == strcmp(src + strlen(src) - 2, ",-")))
+				need_logger = 1;
+		}
+		else if (0 != strcmp(argv[i], "-A") &&
+			0 != strcmp(argv[i], "-x") &&
+			0 != strcmp(argv[i], "-D") &&
+			0 != strcmp(argv[i], "-S") &&
+			0 != strcmp(argv[i], "-q") &&
+			0 != strcmp(argv[i], "-o") &&
+			0 != strcmp(argv[i], "-b") &&
+			0 != strcmp(argv[i], "-G") &&
+			0 != strcmp(argv[i], "-F") &&
+			0 != strcmp(argv[i], "-H") &&
+			0 != strcmp(argv[i], "-w") &&
+			0 != strcmp(argv[i], "-l"))
+			need_logger = 1;
+	}
+	
+	/* replay and converting stored data need no logger */
+	if (transcript_in != NULL || !need_logger)
+		goto commands;
+	
 	// init
 	usb_init();
 //usb_set_debug(255);
@@ -794,112 +3819,289 @@ int main (int argc, char **argv)
 		goto cleanup;
 	}
 	
-	dev_hdl = usb_open(dev);
-
+	dev_hdl = open_logger(dev);
 	if (dev_hdl == NULL)
-	{
-		printf("usb_open failed: %s\n", usb_strerror());
-		goto cleanup;
-	}
-    EP_OUT = dev->config[0].interface[0].altsetting[0].endpoint[0].bEndpointAddress;
-    EP_IN = dev->config[0].interface[0].altsetting[0].endpoint[1].bEndpointAddress;
-	
-	ret = usb_reset(dev_hdl);
-	if (ret < 0)
-	{
-		printf("usb_reset failed with status %i: %s\n", ret, usb_strerror());
-		goto cleanup;
-	}
-	
-	ret = usb_set_configuration(dev_hdl, 1); // bConfigurationValue=1, iConfiguration=0
-	if (ret < 0)
-	{
-		printf("usb_set_configuration failed with status %i\n", ret);
-		goto cleanup;
-	}
-	
-	ret = usb_claim_interface(dev_hdl, 0); // bInterfaceNumber=0, bAlternateSetting=0, bNumEndpoints=2
-	if (ret < 0)
-	{
-		printf("usb_claim_interface failed with status %i: %s\n", ret, usb_strerror());
 		goto cleanup;
-	}
 	
 	
+commands:
 	
-	/* configure logger */
-	
-	if (0 == strcmp(argv[1], "-c"))
+	for (i = 1; i < argc; i += 1 + command_args(argv[i]))
 	{
-		struct config *cfg = NULL;
-		int num_data = atoi(argv[3]);
-		int interval = atoi(argv[4]);
+		/* read config and data on first use only */
 		
-		/* at this point, the original software would do read_config(), */
-		/* which seems not to be necessary for correct operation. */
-		//cfg = read_config(dev_hdl);
+		if (0 == strcmp(argv[i], "-i") ||
+			0 == strcmp(argv[i], "-p") ||
+			0 == strcmp(argv[i], "-s") ||
+			0 == strcmp(argv[i], "-a") ||
+			0 == strcmp(argv[i], "-d") ||
+			0 == strcmp(argv[i], "-g"))
+		{
+			if (cfg == NULL)
+				cfg = read_config(dev_hdl);
+			if (cfg == NULL)
+			{
+				printf("%s: failed to read config\n", argv[i]);
+				goto cleanup;
+			}
+		}
 		
-		cfg = build_config(
-			argv[2], // name
-			num_data, interval,
-			0, 40, // temp thresh
-			35, 75, // rh thresh
-			0, // fahrenheit
-			0, 10, // led alarm, frequency
-			// 1 // start manual
-			2 // start automatic
-		);
-		print_config(cfg, "config->");
-		if (0 != check_config(cfg))
+		if (0 == strcmp(argv[i], "-p") ||
+			0 == strcmp(argv[i], "-a") ||
+			0 == strcmp(argv[i], "-d") ||
+			0 == strcmp(argv[i], "-g"))
 		{
-			printf("config invalid!\n");
-			goto cleanup;
+			if (data_first == NULL && config_num_data_rec(cfg) > 0)
+			{
+				data_first = read_data(dev_hdl, cfg);
+				if (data_first == NULL)
+				{
+					printf("%s: failed to read data\n", argv[i]);
+					goto cleanup;
+				}
+			}
 		}
-		write_config(dev_hdl, cfg);
 		
-		free(cfg); cfg = NULL;
-	}
-	
-	/* print config */
-	
-	if (0 == strcmp(argv[1], "-i"))
-	{
-		struct config *cfg = NULL;
+		/* configure logger */
 		
-		cfg = read_config(dev_hdl);
-		print_config(cfg, "config->");
+		if (0 == strcmp(argv[i], "-c"))
+		{
+			struct config *cfg_new = NULL;
+			int num_data = atoi(argv[i+2]);
+			int interval = atoi(argv[i+3]);
+			
+			/* at this point, the original software would do read_config(), */
+			/* which seems not to be necessary for correct operation. */
+			//cfg = read_config(dev_hdl);
+			
+			cfg_new = build_config(
+				argv[i+1], // name
+				num_data, interval,
+				0, 40, // temp thresh
+				35, 75, // rh thresh
+				0, // fahrenheit
+				0, 10, // led alarm, frequency
+				// 1 // start manual
+				2 // start automatic
+			);
+			if (cfg_new == NULL)
+				goto cleanup;
+			print_config(cfg_new, "config->");
+			if (0 != check_config(cfg_new))
+			{
+				printf("config invalid!\n");
+				free(cfg_new);
+				goto cleanup;
+			}
+			ret = write_config(dev_hdl, cfg_new);
+			free(cfg_new); cfg_new = NULL;
+			if (ret != 0)
+				goto cleanup;
+			
+			/* the logger starts a new log, forget the old one */
+			free_data(data_first); data_first = NULL;
+			free(cfg); cfg = NULL;
+		}
 		
-		free(cfg); cfg = NULL;
-	}
-	
-	/* print data */
-	
-	if (0 == strcmp(argv[1], "-p"))
-	{
-		struct config *cfg = NULL;
-		struct data *data_first;
+		/* print config */
 		
-		cfg = read_config(dev_hdl);
-		data_first = read_data(dev_hdl, cfg);
-		print_data(data_first);
+		if (0 == strcmp(argv[i], "-i"))
+		{
+			print_config(cfg, "config->");
+		}
 		
-		free(cfg); cfg = NULL;
-	}
-	
-	/* store log data in file */
-	if (0 == strcmp(argv[1], "-s"))
-	{
-		struct config *cfg = NULL;
-		cfg = read_config(dev_hdl);
-		//print_config(cfg, "config->");
+		/* print data */
 		
-		struct data *data_first;
-		data_first = read_data(dev_hdl, cfg);
-		//print_data(data_first);
-		store_data(cfg, data_first);
-		free(cfg); cfg = NULL;
+		if (0 == strcmp(argv[i], "-p"))
+		{
+			print_data(data_first);
+		}
+		
+		/* store log data in file */
+		
+		if (0 == strcmp(argv[i], "-s"))
+		{
+			if (catalog_has(cfg))
+				printf("%.16s.dat holds this log already, see %.16s.cat\n", config_name(cfg), config_name(cfg));
+			else if (data_first == NULL && config_num_data_rec(cfg) > 0)
+			{
+				/* not downloaded yet, store while downloading */
+				data_first = read_store_data(dev_hdl, cfg);
+				if (data_first == NULL)
+				{
+					printf("%s: failed to read and store data\n", argv[i]);
+					goto cleanup;
+				}
+			}
+			else if (0 != store_data(cfg, data_first))
+				goto cleanup;
+		}
+		
+		/* store log data in arrow file */
+		
+		if (0 == strcmp(argv[i], "-a") && data_first != NULL)
+		{
+			char path[1024];
+			
+			snprintf(path, sizeof(path), "%.16s.arrow", config_name(cfg));
+			if (0 != store_arrow(cfg, data_first, path))
+				goto cleanup;
+		}
+		
+		/* convert stored data to arrow file */
+		
+		if (0 == strcmp(argv[i], "-A"))
+		{
+			if (0 != convert_arrow(argv[i+1]))
+				goto cleanup;
+		}
+		
+		/* store log data in SQLite database */
+		
+		if (0 == strcmp(argv[i], "-d") && data_first != NULL)
+		{
+			if (0 != store_db(cfg, data_first, argv[i+1]))
+				goto cleanup;
+		}
+		
+		/* convert stored data to SQLite database */
+		
+		if (0 == strcmp(argv[i], "-D"))
+		{
+			if (0 != convert_db(argv[i+1], argv[i+2]))
+				goto cleanup;
+		}
+		
+		/* convert stored data to gnuplot binary file */
+		
+		if (0 == strcmp(argv[i], "-x"))
+		{
+			if (0 != convert_gnuplot(argv[i+1]))
+				goto cleanup;
+		}
+		
+		/* render log data */
+		
+		if (0 == strcmp(argv[i], "-g"))
+		{
+			if (0 != render_data(cfg, data_first, argv[i+1]))
+				goto cleanup;
+		}
+		
+		/* render stored data */
+		
+		if (0 == strcmp(argv[i], "-G"))
+		{
+			if (0 != render_archive(argv[i+1], argv[i+2]))
+				goto cleanup;
+		}
+		
+		/* join log data of several loggers */
+		
+		if (0 == strcmp(argv[i], "-j"))
+		{
+			if (need_logger)
+			{
+				if (cfg == NULL)
+					cfg = read_config(dev_hdl);
+				if (cfg == NULL)
+				{
+					printf("%s: failed to read config\n", argv[i]);
+					goto cleanup;
+				}
+				if (data_first == NULL && config_num_data_rec(cfg) > 0)
+					data_first = read_data(dev_hdl, cfg);
+			}
+			if (0 != join_data(argv[i+3], argv[i+1], atoi(argv[i+2]), cfg, data_first))
+				goto cleanup;
+		}
+		
+		/* rebuild histogram sketches */
+		
+		if (0 == strcmp(argv[i], "-S"))
+		{
+			if (0 != sketch_archive(argv[i+1], 0))
+				goto cleanup;
+		}
+		
+		/* percentiles and bands from histogram sketches */
+		
+		if (0 == strcmp(argv[i], "-q"))
+		{
+			if (0 != query_sketches(argv[i+1], argv[i+2], argv[i+3], argv[i+4]))
+				goto cleanup;
+		}
+		
+		/* roll up old data */
+		
+		if (0 == strcmp(argv[i], "-o"))
+		{
+			if (0 != compact_archive(argv[i+3], atoi(argv[i+1]), atoi(argv[i+2])))
+				goto cleanup;
+		}
+		
+		/* aggregates of stored and rolled up data */
+		
+		if (0 == strcmp(argv[i], "-b"))
+		{
+			if (0 != query_rollup(argv[i+1], argv[i+2], atoi(argv[i+3]), argv[i+4]))
+				goto cleanup;
+		}
+		
+		/* rotate logs */
+		
+		if (0 == strcmp(argv[i], "-r"))
+		{
+			if (0 != rotate_data(dev_hdl, atoi(argv[i+1])))
+				goto cleanup;
+		}
+		
+		/* rotate all loggers */
+		
+		if (0 == strcmp(argv[i], "-F"))
+		{
+			if (0 != fleet_data(atoi(argv[i+1]), atoi(argv[i+2])))
+				goto cleanup;
+		}
+		
+		/* download loggers when plugged in */
+		
+		if (0 == strcmp(argv[i], "-H"))
+		{
+			if (0 != hotplug_data(atoi(argv[i+1])))
+				goto cleanup;
+		}
+		
+		/* print the shared memory table */
+		
+		if (0 == strcmp(argv[i], "-l"))
+		{
+			if (0 != live_print(argv[i+1]))
+				goto cleanup;
+		}
+		
+		/* watch all loggers for alarms */
+		
+		if (0 == strcmp(argv[i], "-w"))
+		{
+			if (0 != watch_data(argv[i+1], atof(argv[i+2]), atoi(argv[i+3])))
+				goto cleanup;
+		}
+		
+		/* follow log data */
+		
+		if (0 == strcmp(argv[i], "-f"))
+		{
+			if (0 != follow_data(dev_hdl))
+				goto cleanup;
+			
+			/* the logger went on logging meanwhile */
+			free_data(data_first); data_first = NULL;
+			free(cfg); cfg = NULL;
+		}
 	}
 	
+	status = 0;
 	goto cleanup;
 	
 	
@@ -914,7 +4116,7 @@ int main (int argc, char **argv)
 	buf[1] = 0x00;
 	buf[2] = 0x40;
 	
-	ret = usb_bulk_write(
+	ret = bulk_write(
 		dev_hdl,
 		EP_OUT,
 		buf,
@@ -941,7 +4143,7 @@ int main (int argc, char **argv)
 	
 	// read response header (3 byte)
 	
-	ret = usb_bulk_read(
+	ret = bulk_read(
 		dev_hdl,
 		EP_IN,
 		buf,
@@ -1075,7 +4277,7 @@ int main (int argc, char **argv)
 	
 	while (num_data_collected < num_data_rec)
 	{
-		ret = usb_bulk_read(
+		ret = bulk_read(
 			dev_hdl,
 			EP_IN,
 			buf,
@@ -1146,10 +4348,15 @@ printf("ok loop\n");
 	free(cur_time);
 	
 cleanup:
+	influx_close();
+	transcript_close();
+	calib_free();
+	free_data(data_first);
+	free(cfg);
 	free(buf);
 	if (log_start != NULL)
 		free(log_start);
 	if (dev_hdl != NULL)
 		usb_close(dev_hdl);
-	return 0;
+	return status;
 }
@@ -0,0 +1,153 @@
+/* vdl120shm.h: the latest readings of all loggers, in shared memory */
+
+/*
+*  with -L NAME, vdl120 keeps a table of all loggers it talks to in the
+*  posix shared memory object NAME, /dev/shm/NAME on linux: the newest
+*  data points, the config as last read and health counters. a collector
+*  like 'vdl120 -L /vdl120 -w - 0 0' keeps it current, and any number of
+*  local programs read it without talking to the logger or to vdl120:
+*
+*   struct vdl120shm *table = vdl120shm_map("/vdl120");
+*   struct vdl120shm_logger l;
+*   struct vdl120shm_sample *s;
+*
+*   for (i = 0; i < table->num_loggers; i++)
+*   {
+*       vdl120shm_read(table, i, &l);
+*       if (l.used && (s = vdl120shm_sample(&l, 0)) != NULL)
+*           printf("%.16s %.1f %.1f\n", l.name, s->temp / 10.0, s->rh / 10.0);
+*   }
+*
+*  each slot is a seqlock: vdl120 makes seq odd, writes the slot and makes
+*  seq even again. vdl120shm_read copies the slot and copies again if seq
+*  was odd or changed meanwhile, so it gets a consistent slot without
+*  locks or syscalls, and a reader can never hold up vdl120.
+*
+*  times are unix times. data point times are the logger's local time
+*  taken as UTC, as everywhere in vdl120; the health times are real UTC.
+*  values are tenths of °C (°F if fahrenheit) and %.
+*
+*  the layout only changes together with VDL120SHM_VERSION.
+*/
+
+#ifndef VDL120SHM_H
+#define VDL120SHM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define VDL120SHM_MAGIC "VDL120S"
+#define VDL120SHM_VERSION 1
+#define VDL120SHM_LOGGERS 64            /* slots */
+#define VDL120SHM_SAMPLES 16            /* newest data points per logger */
+
+struct vdl120shm_sample {
+	int64_t time;
+	int16_t temp;                   /* tenths */
+	int16_t rh;                     /* tenths */
+	uint32_t unused;
+};
+
+struct vdl120shm_logger {
+	uint32_t seq;                   /* odd while vdl120 writes the slot */
+	uint32_t used;                  /* 1 = slot holds a logger */
+	char name[16];                  /* config name, not terminated if 16 long */
+	char location[32];              /* "usb:BUS/DEVICE" */
+
+	/* the config as last read */
+	uint8_t config[64];             /* as sent by the logger, see src/config.c */
+	int64_t start_time;             /* start of the log */
+	int32_t interval;               /* seconds */
+	int32_t num_data_conf;
+	int32_t num_data_rec;
+	int32_t fahrenheit;             /* 1 = temp in °F */
+	int32_t thresh_temp_low;        /* whole units */
+	int32_t thresh_temp_high;
+	int32_t thresh_rh_low;
+	int32_t thresh_rh_high;
+
+	/* the newest data points, see vdl120shm_sample() */
+	uint32_t num_samples;           /* valid, up to VDL120SHM_SAMPLES */
+	uint32_t next;                  /* slot of the next data point */
+	struct vdl120shm_sample sample[VDL120SHM_SAMPLES];
+
+	/* health */
+	uint64_t polls;                 /* config reads */
+	uint64_t failures;              /* failed reads of config or data */
+	uint64_t data_points;           /* data points published */
+	int64_t last_poll;
+	int64_t last_data;              /* when the newest data point came in */
+	int64_t last_failure;
+} __attribute__((aligned(64)));
+
+struct vdl120shm {
+	char magic[8];                  /* VDL120SHM_MAGIC */
+	uint32_t version;               /* VDL120SHM_VERSION */
+	uint32_t logger_size;           /* sizeof(struct vdl120shm_logger) */
+	uint32_t num_loggers;           /* slots, VDL120SHM_LOGGERS */
+	uint32_t pid;                   /* of the vdl120 writing the table */
+	int64_t started;                /* when it created the table */
+	struct vdl120shm_logger logger[VDL120SHM_LOGGERS] __attribute__((aligned(64)));
+};
+
+/* map the table read-only, NULL = missing or of another version */
+static inline struct vdl120shm *vdl120shm_map(const char *name)
+{
+	struct vdl120shm *table;
+	struct stat st;
+	int fd;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct vdl120shm))
+	{
+		close(fd);
+		return NULL;
+	}
+	table = (struct vdl120shm *)mmap(NULL, sizeof(struct vdl120shm), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (table == MAP_FAILED)
+		return NULL;
+	if (memcmp(table->magic, VDL120SHM_MAGIC, 8) != 0 || table->version != VDL120SHM_VERSION ||
+		table->logger_size != sizeof(struct vdl120shm_logger))
+	{
+		munmap(table, sizeof(struct vdl120shm));
+		return NULL;
+	}
+	return table;
+}
+
+static inline void vdl120shm_unmap(struct vdl120shm *table)
+{
+	munmap(table, sizeof(struct vdl120shm));
+}
+
+/* consistent copy of slot i */
+static inline void vdl120shm_read(const struct vdl120shm *table, int i, struct vdl120shm_logger *out)
+{
+	const struct vdl120shm_logger *slot = &table->logger[i];
+	uint32_t seq;
+
+	do
+	{
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		memcpy(out, slot, sizeof(*out));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	}
+	while ((seq & 1) || seq != __atomic_load_n(&slot->seq, __ATOMIC_RELAXED));
+}
+
+/* k-th newest data point of a copied slot, 0 = newest, NULL = none */
+static inline struct vdl120shm_sample *vdl120shm_sample(struct vdl120shm_logger *l, unsigned int k)
+{
+	if (k >= l->num_samples)
+		return NULL;
+	return &l->sample[(l->next + VDL120SHM_SAMPLES - 1 - k) % VDL120SHM_SAMPLES];
+}
+
+#endif
@@ -0,0 +1,511 @@
+/* fakeusb: an emulated DL-120TH behind the libusb-0.1 api, with faults */
+
+/*
+*  build: make fakeusb
+*  use:   LD_PRELOAD=./fakeusb.so FAKEUSB_SCENARIO=slow-hub ./vdl120 -s
+*
+*  the preloaded functions replace those of libusb, so vdl120 talks to
+*  emulated loggers instead of usb, and every bulk transfer can be
+*  delayed, cut short or failed the way slow hubs and flaky cables do.
+*
+*  the loggers, fake0, fake1, ...:
+*
+*   FAKEUSB_LOGGERS    number of loggers, default 1
+*   FAKEUSB_BUSSES     spread over this many busses, default 1
+*   FAKEUSB_RECORDED   data points recorded, default 3000
+*   FAKEUSB_CAPACITY   data points configured, default 16000
+*   FAKEUSB_INTERVAL   log interval in seconds, default 60
+*   FAKEUSB_GROW       data points recorded per second while running
+*
+*  the faults, counted per logger over its bulk reads:
+*
+*   FAKEUSB_LATENCY_US      delay of each transfer
+*   FAKEUSB_JITTER_US       random extra delay, 0 .. N
+*   FAKEUSB_SHORT           at most N bytes per read, short packets
+*   FAKEUSB_TIMEOUT_EVERY   every Nth read times out, after the timeout
+*   FAKEUSB_STALL_AT        read N stalls the endpoint until usb_reset
+*   FAKEUSB_UNPLUG_AT       from read N on the logger is gone
+*   FAKEUSB_SEED            for the jitter, default 1
+*
+*  FAKEUSB_SCENARIO presets some of them, the variables above override it:
+*
+*   clean      no faults
+*   slow-hub   1 ms latency, 0.5 ms jitter
+*   jitter     0.1 ms latency, 3 ms jitter
+*   short      packets of 20 bytes, cut in the middle of data points
+*   timeouts   every 6th read times out
+*   stall      the 5th read stalls
+*   unplug     the logger is unplugged at the 8th read
+*
+*  at exit a summary of the transfers and faults goes to stderr.
+*/
+
+/* libusb-0.1 and libusb-compat differ in the constness of the write */
+/* buffer, so keep their prototype out of the way */
+#define usb_bulk_write fakeusb_usb_bulk_write
+#include <usb.h>
+#undef usb_bulk_write
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#define FAKEUSB_MAX 64
+
+struct usb_dev_handle {
+	int index;
+};
+
+struct fakeusb_logger {
+	unsigned char cfg[64];
+	int recorded;                   /* at t0 */
+	double t0;
+	int state;                      /* 0 = idle, 1 = config write expected, 2 = data dump */
+	int block;                      /* of the data dump */
+	int pos;                        /* bytes sent of the block */
+	int header;                     /* bool: response header pending */
+	int config_reply;               /* 2 = header pending, 1 = config pending */
+	int write_reply;                /* bool: 0xff pending */
+	int num_reads;
+	int stalled;                    /* bool */
+	struct usb_dev_handle handle;
+	pthread_mutex_t lock;
+};
+
+struct fakeusb_fault {
+	long latency_us;
+	long jitter_us;
+	int short_len;
+	int timeout_every;
+	int stall_at;
+	int unplug_at;
+	unsigned int seed;
+};
+
+static struct fakeusb_logger loggers[FAKEUSB_MAX];
+static struct usb_bus busses[16];
+static struct usb_device devices[FAKEUSB_MAX];
+static struct usb_config_descriptor config;
+static struct usb_interface interface;
+static struct usb_interface_descriptor altsetting;
+static struct usb_endpoint_descriptor endpoints[2];
+static int num_loggers = 1, num_busses = 1;
+static struct fakeusb_fault fault;
+static pthread_mutex_t fault_lock = PTHREAD_MUTEX_INITIALIZER;
+static char error[128] = "";
+
+/* summary */
+static long num_reads, num_writes, num_faults, delay_us;
+
+
+static double fakeusb_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static long fakeusb_env(char *name, long value)
+{
+	char *env = getenv(name);
+
+	return env != NULL ? atol(env) : value;
+}
+
+static void fakeusb_put32(unsigned char *p, int value)
+{
+	p[0] = value & 0xFF;
+	p[1] = (value >> 8) & 0xFF;
+	p[2] = (value >> 16) & 0xFF;
+	p[3] = (value >> 24) & 0xFF;
+}
+
+static int fakeusb_get32(unsigned char *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | p[3] << 24;
+}
+
+static int fakeusb_recorded(struct fakeusb_logger *l)
+{
+	int num = l->recorded + (int)((fakeusb_now() - l->t0) * fakeusb_env("FAKEUSB_GROW", 0));
+	int capacity = fakeusb_get32(l->cfg + 4);
+
+	return num < capacity ? num : capacity;
+}
+
+/* data point i of logger index: saw teeth around 22 °C and 51 % */
+static void fakeusb_sample(int index, int i, unsigned char *out)
+{
+	short int temp = 200 + i % 50 + index, rh = 500 + i % 30;
+
+	out[0] = temp & 0xFF;
+	out[1] = temp >> 8;
+	out[2] = rh & 0xFF;
+	out[3] = rh >> 8;
+}
+
+static void fakeusb_sleep(long usec)
+{
+	struct timespec pause;
+
+	if (usec <= 0)
+		return;
+	pause.tv_sec = usec / 1000000;
+	pause.tv_nsec = usec % 1000000 * 1000;
+	nanosleep(&pause, NULL);
+	__sync_fetch_and_add(&delay_us, usec);
+}
+
+/* latency and jitter of one transfer */
+static void fakeusb_delay(void)
+{
+	long usec = fault.latency_us;
+
+	if (fault.jitter_us > 0)
+	{
+		pthread_mutex_lock(&fault_lock);
+		usec += rand_r(&fault.seed) % (fault.jitter_us + 1);
+		pthread_mutex_unlock(&fault_lock);
+	}
+	fakeusb_sleep(usec);
+}
+
+static int fakeusb_fail(int code, char *what)
+{
+	__sync_fetch_and_add(&num_faults, 1);
+	snprintf(error, sizeof(error), "fakeusb: %s", what);
+	return code;
+}
+
+static void fakeusb_scenario(char *name)
+{
+	if (name == NULL || 0 == strcmp(name, "clean"))
+		return;
+	if (0 == strcmp(name, "slow-hub"))
+	{
+		fault.latency_us = 1000;
+		fault.jitter_us = 500;
+	}
+	else if (0 == strcmp(name, "jitter"))
+	{
+		fault.latency_us = 100;
+		fault.jitter_us = 3000;
+	}
+	else if (0 == strcmp(name, "short"))
+		fault.short_len = 20;
+	else if (0 == strcmp(name, "timeouts"))
+		fault.timeout_every = 6;
+	else if (0 == strcmp(name, "stall"))
+		fault.stall_at = 5;
+	else if (0 == strcmp(name, "unplug"))
+		fault.unplug_at = 8;
+	else
+		fprintf(stderr, "fakeusb: unknown scenario %s, using clean\n", name);
+}
+
+static void fakeusb_summary(void) __attribute__((destructor));
+static void fakeusb_summary(void)
+{
+	fprintf(stderr, "fakeusb: %li reads, %li writes, %li faults, %.1f ms delay\n",
+		num_reads, num_writes, num_faults, delay_us / 1000.0);
+}
+
+
+void usb_init(void)
+{
+	struct fakeusb_logger *l;
+	int i;
+
+	fakeusb_scenario(getenv("FAKEUSB_SCENARIO"));
+	fault.latency_us = fakeusb_env("FAKEUSB_LATENCY_US", fault.latency_us);
+	fault.jitter_us = fakeusb_env("FAKEUSB_JITTER_US", fault.jitter_us);
+	fault.short_len = fakeusb_env("FAKEUSB_SHORT", fault.short_len);
+	fault.timeout_every = fakeusb_env("FAKEUSB_TIMEOUT_EVERY", fault.timeout_every);
+	fault.stall_at = fakeusb_env("FAKEUSB_STALL_AT", fault.stall_at);
+	fault.unplug_at = fakeusb_env("FAKEUSB_UNPLUG_AT", fault.unplug_at);
+	fault.seed = fakeusb_env("FAKEUSB_SEED", 1);
+
+	num_loggers = fakeusb_env("FAKEUSB_LOGGERS", 1);
+	num_busses = fakeusb_env("FAKEUSB_BUSSES", 1);
+	if (num_loggers < 1 || num_loggers > FAKEUSB_MAX)
+		num_loggers = 1;
+	if (num_busses < 1 || num_busses > 16)
+		num_busses = 1;
+
+	for (i = 0; i < num_loggers; i++)
+	{
+		l = &loggers[i];
+		memset(l, 0, sizeof(*l));
+		fakeusb_put32(l->cfg + 4, fakeusb_env("FAKEUSB_CAPACITY", 16000));
+		fakeusb_put32(l->cfg + 12, fakeusb_env("FAKEUSB_INTERVAL", 60));
+		fakeusb_put32(l->cfg + 16, 2010);
+		l->cfg[26] = 0x20; l->cfg[27] = 0x42; /* temp thresholds 0 .. 40 */
+		l->cfg[28] = 7;                       /* started 2010-07-01 14:40:30 */
+		l->cfg[29] = 1;
+		l->cfg[30] = 14;
+		l->cfg[31] = 40;
+		l->cfg[32] = 30;
+		l->cfg[34] = 10;
+		snprintf((char *)l->cfg + 35, 16, "fake%i", i);
+		l->cfg[51] = 2;
+		l->cfg[54] = 0x0c; l->cfg[55] = 0x42; /* rh thresholds 35 .. 75 */
+		l->cfg[58] = 0x96; l->cfg[59] = 0x42;
+		l->recorded = fakeusb_env("FAKEUSB_RECORDED", 3000);
+		l->t0 = fakeusb_now();
+		l->handle.index = i;
+		pthread_mutex_init(&l->lock, NULL);
+	}
+}
+
+int usb_find_busses(void)
+{
+	return num_busses;
+}
+
+int usb_find_devices(void)
+{
+	struct usb_device *dev;
+	struct usb_bus *bus;
+	int i;
+
+	endpoints[0].bEndpointAddress = 0x02;
+	endpoints[1].bEndpointAddress = 0x81;
+	altsetting.bNumEndpoints = 2;
+	altsetting.endpoint = endpoints;
+	interface.altsetting = &altsetting;
+	interface.num_altsetting = 1;
+	config.bNumInterfaces = 1;
+	config.interface = &interface;
+
+	for (i = 0; i < num_busses; i++)
+	{
+		memset(&busses[i], 0, sizeof(busses[i]));
+		snprintf(busses[i].dirname, sizeof(busses[i].dirname), "%03i", i + 1);
+		busses[i].location = i + 1;
+		if (i > 0)
+		{
+			busses[i-1].next = &busses[i];
+			busses[i].prev = &busses[i-1];
+		}
+	}
+	for (i = 0; i < num_loggers; i++)
+	{
+		dev = &devices[i];
+		bus = &busses[i % num_busses];
+		memset(dev, 0, sizeof(*dev));
+		dev->descriptor.idVendor = 0x10c4;
+		dev->descriptor.idProduct = i % 2 ? 0xea61 : 0x0003;
+		dev->config = &config;
+		dev->bus = bus;
+		dev->devnum = 10 + i;
+		snprintf(dev->filename, sizeof(dev->filename), "%03i", 10 + i);
+		dev->dev = &loggers[i];
+		dev->next = bus->devices;
+		bus->devices = dev;
+	}
+	return num_loggers;
+}
+
+struct usb_bus *usb_get_busses(void)
+{
+	return &busses[0];
+}
+
+usb_dev_handle *usb_open(struct usb_device *dev)
+{
+	return &((struct fakeusb_logger *)dev->dev)->handle;
+}
+
+int usb_close(usb_dev_handle *dev)
+{
+	return 0;
+}
+
+struct usb_device *usb_device(usb_dev_handle *dev)
+{
+	return &devices[dev->index];
+}
+
+int usb_reset(usb_dev_handle *dev)
+{
+	loggers[dev->index].stalled = 0;
+	return 0;
+}
+
+int usb_clear_halt(usb_dev_handle *dev, unsigned int ep)
+{
+	loggers[dev->index].stalled = 0;
+	return 0;
+}
+
+int usb_set_configuration(usb_dev_handle *dev, int configuration)
+{
+	return 0;
+}
+
+int usb_claim_interface(usb_dev_handle *dev, int interface)
+{
+	return 0;
+}
+
+int usb_release_interface(usb_dev_handle *dev, int interface)
+{
+	return 0;
+}
+
+char *usb_strerror(void)
+{
+	return error;
+}
+
+void usb_set_debug(int level)
+{
+}
+
+int usb_bulk_write(usb_dev_handle *dev, int ep, char *bytes, int size, int timeout)
+{
+	struct fakeusb_logger *l = &loggers[dev->index];
+	unsigned char *u = (unsigned char *)bytes;
+	int ret = size;
+
+	__sync_fetch_and_add(&num_writes, 1);
+	fakeusb_delay();
+
+	pthread_mutex_lock(&l->lock);
+	if (fault.unplug_at > 0 && l->num_reads >= fault.unplug_at)
+		ret = fakeusb_fail(-ENODEV, "no such device");
+	else if (l->stalled)
+		ret = fakeusb_fail(-EPIPE, "endpoint stalled");
+	else if (l->state == 1 && size == 64)
+	{
+		/* new config: the logger starts a new log */
+		memcpy(l->cfg, bytes, 64);
+		l->recorded = 0;
+		l->t0 = fakeusb_now();
+		l->state = 0;
+		l->write_reply = 1;
+	}
+	else if (size == 3 && u[0] == 0x00 && u[1] == 0x10 && u[2] == 0x01)
+	{
+		l->state = 0;
+		l->config_reply = 2;
+	}
+	else if (size == 3 && u[0] == 0x01 && u[1] == 0x40 && u[2] == 0x00)
+		l->state = 1;
+	else if (size == 3 && u[0] == 0x00 && u[1] == 0x00 && u[2] == 0x40)
+	{
+		l->state = 2;
+		l->block = 0;
+		l->pos = 0;
+		l->header = 1;
+	}
+	else if (size == 3 && u[0] == 0x00 && u[1] == 0x01 && u[2] == 0x40 && l->state == 2)
+	{
+		l->block++;
+		l->pos = 0;
+		l->header = 1;
+	}
+	else
+	{
+		fprintf(stderr, "fakeusb: unexpected write of %i bytes\n", size);
+		ret = -EIO;
+	}
+	pthread_mutex_unlock(&l->lock);
+	return ret;
+}
+
+int usb_bulk_read(usb_dev_handle *dev, int ep, char *bytes, int size, int timeout)
+{
+	struct fakeusb_logger *l = &loggers[dev->index];
+	unsigned char sample[4], cfg[64];
+	int ret, num, first, avail, k;
+
+	__sync_fetch_and_add(&num_reads, 1);
+	fakeusb_delay();
+
+	pthread_mutex_lock(&l->lock);
+	l->num_reads++;
+
+	if (fault.unplug_at > 0 && l->num_reads >= fault.unplug_at)
+	{
+		pthread_mutex_unlock(&l->lock);
+		return fakeusb_fail(-ENODEV, "no such device");
+	}
+	if (fault.stall_at > 0 && l->num_reads == fault.stall_at)
+		l->stalled = 1;
+	if (l->stalled)
+	{
+		pthread_mutex_unlock(&l->lock);
+		return fakeusb_fail(-EPIPE, "endpoint stalled");
+	}
+	if (fault.timeout_every > 0 && l->num_reads % fault.timeout_every == 0)
+	{
+		/* nothing arrives, the data stays for the next read */
+		pthread_mutex_unlock(&l->lock);
+		fakeusb_sleep(timeout * 1000L);
+		return fakeusb_fail(-ETIMEDOUT, "connection timed out");
+	}
+
+	ret = -ETIMEDOUT;
+	if (l->write_reply)
+	{
+		l->write_reply = 0;
+		bytes[0] = (char)0xff;
+		ret = 1;
+	}
+	else if (l->config_reply == 2)
+	{
+		num = fakeusb_recorded(l);
+		bytes[0] = 2;
+		bytes[1] = num & 0xFF;
+		bytes[2] = (num >> 8) & 0xFF;
+		l->config_reply = 1;
+		ret = size < 3 ? size : 3;
+	}
+	else if (l->config_reply == 1)
+	{
+		memcpy(cfg, l->cfg, 64);
+		fakeusb_put32(cfg + 8, fakeusb_recorded(l));
+		ret = size < 64 ? size : 64;
+		memcpy(bytes, cfg, ret);
+		l->config_reply = 0;
+	}
+	else if (l->state == 2 && l->header)
+	{
+		l->header = 0;
+		bytes[0] = 2;
+		bytes[1] = 0;
+		bytes[2] = 0;
+		ret = size < 3 ? size : 3;
+	}
+	else if (l->state == 2)
+	{
+		first = l->block * 1024;
+		num = fakeusb_recorded(l) - first;
+		if (num > 1024)
+			num = 1024;
+		avail = num * 4 - l->pos;
+		if (avail > 0)
+		{
+			ret = size < avail ? size : avail;
+			if (fault.short_len > 0 && ret > fault.short_len)
+				ret = fault.short_len;
+			for (k = 0; k < ret; k++)
+			{
+				fakeusb_sample(dev->index, first + (l->pos + k) / 4, sample);
+				bytes[k] = sample[(l->pos + k) % 4];
+			}
+			l->pos += ret;
+		}
+	}
+	pthread_mutex_unlock(&l->lock);
+
+	/* nothing to send, not an injected fault */
+	if (ret < 0)
+		snprintf(error, sizeof(error), "fakeusb: connection timed out");
+	return ret;
+}
@@ -0,0 +1,47 @@
+#!/bin/sh
+# run vdl120 against the emulated logger of fakeusb.so under each scenario
+#
+# usage: tools/scenarios.sh [SCENARIO ...]
+#
+# VDL120 and FAKEUSB give the binaries, default ./vdl120 and ./fakeusb.so.
+# for each scenario a fresh directory gets 'vdl120 -s' of 3000 data points
+# (FAKEUSB_RECORDED), and a line like
+#
+#   slow-hub    ok      0.043 s   3000 stored  fakeusb: 11 reads, ...
+#
+# tells whether the download worked, how long it took, how many data
+# points got into the archive and which faults were injected. a failed
+# download must leave no data points behind, a partial session is
+# reported as BROKEN.
+
+VDL120=$(readlink -f "${VDL120:-./vdl120}")
+FAKEUSB=$(readlink -f "${FAKEUSB:-./fakeusb.so}")
+SCENARIOS=${*:-clean slow-hub jitter short timeouts stall unplug}
+STATUS=0
+
+for scenario in $SCENARIOS
+do
+	dir=$(mktemp -d)
+	start=$(date +%s%N)
+	(cd "$dir" && LD_PRELOAD="$FAKEUSB" FAKEUSB_SCENARIO=$scenario "$VDL120" -s > out 2> err)
+	ret=$?
+	end=$(date +%s%N)
+
+	stored=0
+	[ -f "$dir/fake0.dat" ] && stored=$(grep -vc '^#' "$dir/fake0.dat")
+	expected=${FAKEUSB_RECORDED:-3000}
+	if [ $ret -eq 0 ] && [ "$stored" -eq "$expected" ]; then
+		result=ok
+	elif [ $ret -ne 0 ] && [ "$stored" -eq 0 ]; then
+		result=failed
+	else
+		result=BROKEN
+		STATUS=1
+	fi
+
+	printf "%-10s  %-6s  %6.3f s  %5i stored  %s\n" "$scenario" "$result" \
+		"$(awk "BEGIN { print ($end - $start) / 1e9 }")" "$stored" "$(grep '^fakeusb:' "$dir/err" | tail -n 1)"
+	rm -rf "$dir"
+done
+
+exit $STATUS